@@ -25,6 +25,33 @@
                     },                                
                 }]
             ]
+        },
+        {
+            "target_name": "PA_napi",
+            "sources": [ "panode_napi.cpp" ],
+            "defines": [ "NAPI_VERSION=8" ],
+            'include_dirs': [
+                'pa/include',
+            ],
+            "conditions": [
+                ["OS=='win'", {
+                    "libraries": [ "../pa/lib/win/x64/Release/portaudio_x64.lib" ],
+                    "link_settings": {
+                        "libraries": [
+                            
+                        ]
+                    },            
+                }],
+                ["OS=='mac'", {
+                    "libraries" : [ "../pa/lib/mac/arm64/libportaudio.a"],
+                    "xcode_settings": { "MACOSX_DEPLOYMENT_TARGET": "14.0"},
+                    "link_settings": {
+                        "libraries": [
+                            "-framework AudioToolbox"
+                        ]
+                    },                                
+                }]
+            ]
         }
     ]
 }
@@ -0,0 +1,295 @@
+/*
+ panode_audio.h
+ PortAudioの入出力とサンプルバッファ.
+ V8版(panode.cpp)とN-API版(panode_napi.cpp)の両方から読み込む.
+ */
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "portaudio.h"
+
+/*
+ SampleBuffer
+ サンプルデータを格納しておくリングバッファ.
+ 生産者(書き込み側)と消費者(読み出し側)がそれぞれ1スレッドのSPSCリングで, ロックなしで共有できる.
+   録音: PortAudioのコールバックが書き込み, JSスレッドが読み出す
+   再生: JSスレッドが書き込み, PortAudioのコールバックが読み出す
+ write_pos/read_pos は累計のサンプル数で, 添字は SAMPLE_MAX で割った余り(SAMPLE_MAXは2のべき乗).
+ 読み書きは最大2回のmemcpyで済むので, 量に比例した移動(以前のmemmove)はしない.
+ 生産者は読み出し位置を動かせないので, 満杯のときは書けない分(新しい側)を捨てる. 方向ごとの扱い:
+   録音: 溜まった量が REC_MAX_BACKLOG_MS を超えたら, 消費者(JS)が読む前に古い側を捨てて最新の
+         g_framesPerBuffer サンプルだけ残す(新しい方を優先). JSが止まっても遅延が残り続けない.
+   再生: 満杯なら pushSamplesForPlay が受け付けた数を返すので, 送り手が残りの扱いを決める.
+         足りないときは再生コールバックが無音を出す.
+ */
+#define SAMPLE_MAX 65536
+typedef struct
+{
+    short samples[SAMPLE_MAX];
+    std::atomic<unsigned int> write_pos; /* 生産者だけが進める */
+    std::atomic<unsigned int> read_pos; /* 消費者だけが進める */
+} SampleBuffer;
+#define MAX_FRAMES_PER_BUFFER   (1024)
+#define REC_MAX_BACKLOG_MS 200 /* 録音側で許す溜まりの上限(ミリ秒) */
+
+SampleBuffer *g_recbuf; /* 録音したサンプルデータ */
+SampleBuffer *g_playbuf; /* 再生予定のサンプルデータ */
+
+int g_recFreq=32000;
+int g_playFreq=32000;
+int g_framesPerBuffer=512;
+
+/* 必要なSampleBufferを初期化する.  */
+void initSampleBuffers(int recFreq,int playFreq,int framesPerBuffer) {
+    g_recFreq=recFreq;
+    g_playFreq=playFreq;
+    g_framesPerBuffer=framesPerBuffer;
+    if(g_framesPerBuffer>MAX_FRAMES_PER_BUFFER)g_framesPerBuffer=MAX_FRAMES_PER_BUFFER;
+
+    if(!g_recbuf) g_recbuf = new SampleBuffer();
+    if(!g_playbuf) g_playbuf = new SampleBuffer();
+}
+/* 読み出せるサンプル数 */
+static int usedSamples(const SampleBuffer *buf) {
+    return (int)(buf->write_pos.load(std::memory_order_acquire) - buf->read_pos.load(std::memory_order_acquire));
+}
+/* 消費者側: 先頭から最大num個をoutputへコピーする(読み出し位置は進めない). コピーした数を返す */
+static int peekSamples(const SampleBuffer *buf, short *output, int num) {
+    unsigned int r=buf->read_pos.load(std::memory_order_relaxed);
+    unsigned int w=buf->write_pos.load(std::memory_order_acquire);
+    int n=num;
+    if(n>(int)(w-r)) n=(int)(w-r);
+    int head=(int)(r%SAMPLE_MAX);
+    int first=n;
+    if(first>SAMPLE_MAX-head) first=SAMPLE_MAX-head;
+    memcpy(output,&buf->samples[head],first*sizeof(short));
+    memcpy(output+first,&buf->samples[0],(n-first)*sizeof(short));
+    return n;
+}
+/* 消費者側: 先頭から最大num個を捨てる. 捨てた数を返す */
+static int discardSamples(SampleBuffer *buf, int num) {
+    int n=num;
+    int used=usedSamples(buf);
+    if(n>used) n=used;
+    if(n<0) n=0;
+    buf->read_pos.store(buf->read_pos.load(std::memory_order_relaxed)+n, std::memory_order_release);
+    return n;
+}
+/* 消費者側: 最大num個を取り出す. 取り出した数を返す */
+static int shiftSamples(SampleBuffer *buf, short *output, int num) {
+    int n=peekSamples(buf,output,num);
+    discardSamples(buf,n);
+    return n;
+}
+/* 生産者側: appendを書ける分だけ書き込む. 満杯の分は捨て, 書いた数を返す */
+static int pushSamples(SampleBuffer *buf,const short *append, int num) {
+    unsigned int w=buf->write_pos.load(std::memory_order_relaxed);
+    unsigned int r=buf->read_pos.load(std::memory_order_acquire);
+    int n=num;
+    if(n>SAMPLE_MAX-(int)(w-r)) n=SAMPLE_MAX-(int)(w-r);
+    int tail=(int)(w%SAMPLE_MAX);
+    int first=n;
+    if(first>SAMPLE_MAX-tail) first=SAMPLE_MAX-tail;
+    memcpy(&buf->samples[tail],append,first*sizeof(short));
+    memcpy(&buf->samples[0],append+first,(n-first)*sizeof(short));
+    buf->write_pos.store(w+n, std::memory_order_release);
+    return n;
+}
+
+
+/* 消費者側: 録音が REC_MAX_BACKLOG_MS より多く溜まっていたら, 最新の1周期分を残して古い側を捨てる */
+static void dropStaleRecordedSamples() {
+    int used=usedSamples(g_recbuf);
+    if(used>g_recFreq*REC_MAX_BACKLOG_MS/1000) discardSamples(g_recbuf,used-g_framesPerBuffer);
+}
+/* マイクから受け取ったサンプルの保存されている数を返す(溜まりすぎていれば先に古い側を捨てる) */
+int getRecordedSampleCount() {
+    dropStaleRecordedSamples();
+    return usedSamples(g_recbuf);
+}
+/* 再生するサンプルをまとめて送る. 送れた数を返す */
+int pushSamplesForPlay(const short *samples, int num) {
+    return pushSamples(g_playbuf,samples,num);
+}
+
+int getPlayBufferUsed() {
+    return usedSamples(g_playbuf);
+}
+/* 録音済みサンプルを最大maxnum個コピーする(バッファからは消さない) */
+int getRecordedSamples(short *samples_out, int maxnum) {
+    return peekSamples(g_recbuf,samples_out,maxnum);
+}
+/* 録音済みサンプルを最大maxnum個, unitの倍数だけ取り出す(溜まりすぎていれば先に古い側を捨てる) */
+int readRecordedSamples(short *samples_out, int maxnum, int unit=1) {
+    int n=getRecordedSampleCount();
+    if(n>maxnum) n=maxnum;
+    if(unit>1) n-=n%unit;
+    return shiftSamples(g_recbuf,samples_out,n);
+}
+void discardRecordedSamples(int num) {
+    discardSamples(g_recbuf,num);
+}
+
+///////////////////
+
+// PortAudio 特有の処理
+
+
+#define NUM_CHANNELS 1
+#define BITS_PER_SAMPLE 16
+#define BUFFER_SIZE(hz) (hz * NUM_CHANNELS * BITS_PER_SAMPLE / 8)
+
+#define PA_SAMPLE_TYPE  paInt16
+typedef short SAMPLE;
+typedef unsigned long PaStreamCallbackFlags;
+static PaStream* g_inputStream;
+static PaStream* g_outputStream;
+
+static int recordCallback( const void *inputBuffer, void *outputBuffer,
+                           unsigned long framesPerBuffer,
+                           const PaStreamCallbackTimeInfo* timeInfo,
+                           PaStreamCallbackFlags statusFlags,
+                           void *userData )
+{
+    const SAMPLE *rptr = (const SAMPLE*)inputBuffer;
+    long framesToCalc = framesPerBuffer;
+
+    if( inputBuffer == NULL )
+    {
+        /* 入力がないときは無音を書く */
+        static const short silence[MAX_FRAMES_PER_BUFFER] = {0};
+        while( framesToCalc > 0 )
+        {
+            long n = framesToCalc < MAX_FRAMES_PER_BUFFER ? framesToCalc : MAX_FRAMES_PER_BUFFER;
+            pushSamples(g_recbuf,silence,(int)n);
+            framesToCalc -= n;
+        }
+    }
+    else
+    {
+        /* 入力バッファからリングへ直接コピーする */
+        pushSamples(g_recbuf,rptr,(int)framesToCalc);
+    }
+    return 0;
+}
+
+int startMic() {
+    PaError             err = paNoError;
+
+    err = Pa_Initialize();
+    if (err != paNoError) {
+        return -1;
+    }
+    PaStreamParameters  inputParameters;
+
+    inputParameters.device = Pa_GetDefaultInputDevice(); /* default input device */
+    if (inputParameters.device == paNoDevice) {
+        fprintf(stderr,"Error: No default input device.\n");
+        return -2;
+    }
+    
+    inputParameters.channelCount = 1;                    /* stereo input */
+    inputParameters.sampleFormat = PA_SAMPLE_TYPE;
+    inputParameters.suggestedLatency = Pa_GetDeviceInfo( inputParameters.device )->defaultLowInputLatency;
+    inputParameters.hostApiSpecificStreamInfo = NULL;
+   
+    err = Pa_OpenStream(
+              &g_inputStream,
+              &inputParameters,
+              NULL,                  /* &outputParameters, */
+              g_recFreq,
+              g_framesPerBuffer,
+              paClipOff,      /* we won't output out of range samples so don't bother clipping them */
+              recordCallback,
+              NULL);
+    if( err != paNoError ) return -3;
+
+    err = Pa_StartStream( g_inputStream );
+    if( err != paNoError ) return -4;
+
+    return 0;
+}
+
+int listDevices() {
+    PaError  err = Pa_Initialize();
+    if (err != paNoError) {
+        return -1;
+    }
+    int numDevices;
+    numDevices = Pa_GetDeviceCount();
+    if( numDevices < 0 ) {
+        fprintf(stderr, "ERROR: Pa_CountDevices returned 0x%x\n", numDevices);
+        return -1;
+    }
+    fprintf(stderr, "Number of devices = %d\n", numDevices);
+    for (int i = 0; i < numDevices; i++) {
+        const PaDeviceInfo *deviceInfo;
+        deviceInfo = Pa_GetDeviceInfo(i);
+        //hexDump(deviceInfo->name,strlen(deviceInfo->name));
+
+        fprintf(stderr, "Device %d: %s samplerate:%f\n", i, deviceInfo->name, deviceInfo->defaultSampleRate);
+
+    }
+    return 0;
+}
+
+static int playCallback( const void *inputBuffer, void *outputBuffer,
+                         unsigned long framesPerBuffer,
+                         const PaStreamCallbackTimeInfo* timeInfo,
+                         PaStreamCallbackFlags statusFlags,
+                         void *userData )
+{
+    SAMPLE *wptr = (SAMPLE*)outputBuffer;
+
+    if( usedSamples(g_playbuf) < (int)framesPerBuffer ) {
+        memset(wptr,0,framesPerBuffer*NUM_CHANNELS*sizeof(SAMPLE));
+        return 0;
+    }
+    shiftSamples(g_playbuf,wptr,framesPerBuffer);
+    return 0;
+}
+
+
+int startSpeaker() {
+    PaError  err = Pa_Initialize();
+    if (err != paNoError) {
+        return -1;
+    }
+    PaStreamParameters outputParameters;
+    outputParameters.device = Pa_GetDefaultOutputDevice(); /* default output device */
+    if (outputParameters.device == paNoDevice) {
+        fprintf(stderr,"Error: No default output device.\n");
+        return -1;
+    }
+    outputParameters.channelCount = 1;                     /* stereo output */
+    outputParameters.sampleFormat =  PA_SAMPLE_TYPE;
+    outputParameters.suggestedLatency = Pa_GetDeviceInfo( outputParameters.device )->defaultLowOutputLatency;
+    outputParameters.hostApiSpecificStreamInfo = NULL;
+
+    err = Pa_OpenStream(
+              &g_outputStream,
+              NULL, /* no input */
+              &outputParameters,
+              g_playFreq,
+              g_framesPerBuffer,
+              paClipOff,      /* we won't output out of range samples so don't bother clipping them */
+              playCallback,
+              NULL );
+    if( err != paNoError ) return -2;
+
+    if( !g_outputStream ) return -3;
+
+    err = Pa_StartStream( g_outputStream );
+    if( err != paNoError ) return -4;
+
+    return 0;
+}
+
+void stopMic() {
+    if(g_inputStream) Pa_StopStream( g_inputStream );    
+}
+void stopSpeaker() {
+    if(g_outputStream) Pa_StopStream( g_outputStream );
+}
@@ -0,0 +1,163 @@
+/*
+ panode_napi.cpp
+ N-API(ABI安定)版のバインディング. Node.jsのバージョンを上げても再ビルドせずに使える.
+ 関数名と意味はV8版(panode.cpp)と同じ.
+ readRecordedSamples/pushSamplesForPlay は呼び出し側の Int16Array へ直接読み書きする.
+ SharedArrayBuffer上のビューやWASMの HEAP16.subarray() も渡せるので,
+ デバイスからWASMヒープまでJS側でサンプルごとの処理や中間の配列を挟まずに済む.
+ */
+#include <stdio.h>
+#include <node_api.h>
+
+#include "panode_audio.h"
+
+
+/* 例外を投げて false を返す */
+static bool throwTypeError(napi_env env, const char *msg) {
+    napi_throw_type_error(env, NULL, msg);
+    return false;
+}
+static napi_value makeInt(napi_env env, int v) {
+    napi_value r;
+    napi_create_int32(env, v, &r);
+    return r;
+}
+static napi_value makeUndefined(napi_env env) {
+    napi_value r;
+    napi_get_undefined(env, &r);
+    return r;
+}
+/* 引数を最大maxargc個取り出し, 実際の個数を返す */
+static size_t getArgs(napi_env env, napi_callback_info info, napi_value *argv, size_t maxargc) {
+    size_t argc = maxargc;
+    napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+    return argc;
+}
+static bool getIntArg(napi_env env, napi_value v, int *out) {
+    if( napi_get_value_int32(env, v, out) != napi_ok ) return throwTypeError(env, "Expected an integer");
+    return true;
+}
+/* Int16Arrayのビューが指す範囲(ByteOffset, Length込み)を取り出す */
+static bool getInt16View(napi_env env, napi_value v, short **data, int *length) {
+    bool isTypedArray = false;
+    napi_is_typedarray(env, v, &isTypedArray);
+    if( !isTypedArray ) return throwTypeError(env, "Expected an Int16Array");
+    napi_typedarray_type type;
+    size_t len;
+    void *ptr;
+    if( napi_get_typedarray_info(env, v, &type, &len, &ptr, NULL, NULL) != napi_ok || type != napi_int16_array ) {
+        return throwTypeError(env, "Expected an Int16Array");
+    }
+    *data = (short*)ptr;
+    *length = (int)len;
+    return true;
+}
+
+static napi_value NativeAudio_initSampleBuffers(napi_env env, napi_callback_info info) {
+    napi_value argv[3];
+    int recFreq, playFreq, framesPerBuffer;
+    if( getArgs(env, info, argv, 3) != 3 ) {
+        throwTypeError(env, "Expected 3 single integer arguments");
+        return NULL;
+    }
+    if( !getIntArg(env, argv[0], &recFreq) || !getIntArg(env, argv[1], &playFreq) || !getIntArg(env, argv[2], &framesPerBuffer) ) return NULL;
+    initSampleBuffers(recFreq,playFreq,framesPerBuffer);
+    return makeUndefined(env);
+}
+static napi_value NativeAudio_startMic(napi_env env, napi_callback_info info) {
+    return makeInt(env, startMic());
+}
+static napi_value NativeAudio_stopMic(napi_env env, napi_callback_info info) {
+    stopMic();
+    return makeUndefined(env);
+}
+static napi_value NativeAudio_listDevices(napi_env env, napi_callback_info info) {
+    listDevices();
+    return makeUndefined(env);
+}
+static napi_value NativeAudio_startSpeaker(napi_env env, napi_callback_info info) {
+    return makeInt(env, startSpeaker());
+}
+static napi_value NativeAudio_stopSpeaker(napi_env env, napi_callback_info info) {
+    stopSpeaker();
+    return makeUndefined(env);
+}
+static napi_value NativeAudio_getPlayBufferUsed(napi_env env, napi_callback_info info) {
+    return makeInt(env, getPlayBufferUsed());
+}
+static napi_value NativeAudio_getRecordedSampleCount(napi_env env, napi_callback_info info) {
+    return makeInt(env, getRecordedSampleCount());
+}
+/* pushSamplesForPlay(int16array): ビューの中身を再生バッファへ送り, 送れた数を返す */
+static napi_value NativeAudio_pushSamplesForPlay(napi_env env, napi_callback_info info) {
+    napi_value argv[1];
+    short *data;
+    int length;
+    if( getArgs(env, info, argv, 1) < 1 ) {
+        throwTypeError(env, "Expected an Int16Array");
+        return NULL;
+    }
+    if( !getInt16View(env, argv[0], &data, &length) ) return NULL;
+    return makeInt(env, pushSamplesForPlay(data,length));
+}
+/* getRecordedSamples(): 録音済みサンプルのコピーを新しいInt16Arrayで返す(バッファからは消さない) */
+static napi_value NativeAudio_getRecordedSamples(napi_env env, napi_callback_info info) {
+    int arraySize = getRecordedSampleCount();
+    void *data;
+    napi_value buffer, int16Array;
+    napi_create_arraybuffer(env, arraySize*sizeof(short), &data, &buffer);
+    getRecordedSamples((short*)data,arraySize);
+    napi_create_typedarray(env, napi_int16_array, arraySize, buffer, 0, &int16Array);
+    return int16Array;
+}
+/*
+ readRecordedSamples(int16array[, unit]): 録音済みサンプルをビューへ入るだけ取り出し, 取り出した数を返す.
+ unit を渡すとその倍数だけ取り出す(ブロック単位で処理する側が端数を持ち越さずに済む).
+ */
+static napi_value NativeAudio_readRecordedSamples(napi_env env, napi_callback_info info) {
+    napi_value argv[2];
+    short *data;
+    int length, unit = 1;
+    size_t argc = getArgs(env, info, argv, 2);
+    if( argc < 1 ) {
+        throwTypeError(env, "Expected an Int16Array");
+        return NULL;
+    }
+    if( !getInt16View(env, argv[0], &data, &length) ) return NULL;
+    if( argc >= 2 && !getIntArg(env, argv[1], &unit) ) return NULL;
+    if( unit < 1 ) unit = 1;
+    return makeInt(env, readRecordedSamples(data,length,unit));
+}
+static napi_value NativeAudio_discardRecordedSamples(napi_env env, napi_callback_info info) {
+    napi_value argv[1];
+    int len;
+    if( getArgs(env, info, argv, 1) < 1 ) {
+        throwTypeError(env, "Expected an integer");
+        return NULL;
+    }
+    if( !getIntArg(env, argv[0], &len) ) return NULL;
+    discardRecordedSamples(len);
+    return makeUndefined(env);
+}
+
+
+static napi_value Initialize(napi_env env, napi_value exports) {
+    napi_property_descriptor props[] = {
+        { "initSampleBuffers", NULL, NativeAudio_initSampleBuffers, NULL, NULL, NULL, napi_default, NULL },
+        { "startMic", NULL, NativeAudio_startMic, NULL, NULL, NULL, napi_default, NULL },
+        { "listDevices", NULL, NativeAudio_listDevices, NULL, NULL, NULL, napi_default, NULL },
+        { "startSpeaker", NULL, NativeAudio_startSpeaker, NULL, NULL, NULL, napi_default, NULL },
+        { "pushSamplesForPlay", NULL, NativeAudio_pushSamplesForPlay, NULL, NULL, NULL, napi_default, NULL },
+        { "getRecordedSamples", NULL, NativeAudio_getRecordedSamples, NULL, NULL, NULL, napi_default, NULL },
+        { "getRecordedSampleCount", NULL, NativeAudio_getRecordedSampleCount, NULL, NULL, NULL, napi_default, NULL },
+        { "readRecordedSamples", NULL, NativeAudio_readRecordedSamples, NULL, NULL, NULL, napi_default, NULL },
+        { "discardRecordedSamples", NULL, NativeAudio_discardRecordedSamples, NULL, NULL, NULL, napi_default, NULL },
+        { "getPlayBufferUsed", NULL, NativeAudio_getPlayBufferUsed, NULL, NULL, NULL, napi_default, NULL },
+        { "stopMic", NULL, NativeAudio_stopMic, NULL, NULL, NULL, napi_default, NULL },
+        { "stopSpeaker", NULL, NativeAudio_stopSpeaker, NULL, NULL, NULL, napi_default, NULL },
+    };
+    napi_define_properties(env, exports, sizeof(props)/sizeof(props[0]), props);
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, Initialize)
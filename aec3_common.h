@@ -1,8 +1,12 @@
 // AEC3で共通利用する定数群。元のWebRTC実装から必要最小限を抽出。
 #pragma once
+
+#include <algorithm>
+
 inline constexpr int kNumBlocksPerSecond = 250; // 16 kHz, 64サンプルブロックで1秒あたりのブロック数
 inline constexpr size_t kFftLengthBy2 = 64; // FFTで扱う片側サイズ(周波数ビン数)
 inline constexpr size_t kFftLengthBy2Plus1 = kFftLengthBy2 + 1; // DC〜Nyquistまでのビン数(実数FFT用) (65)
+inline constexpr size_t kFftLengthBy2Plus1Padded = 72; // SIMD処理用にkFftLengthBy2Plus1を8の倍数へ切り上げた長さ
 inline constexpr size_t kFftLengthBy2Minus1 = kFftLengthBy2 - 1; // Nyquistを除いた高周波数側のビン数 (63)
 inline constexpr size_t kFftLength = 2 * kFftLengthBy2; // 実際にIFFTするサンプル長(128)
 inline constexpr size_t kFftLengthBy2Log2 = 6; // kFftLengthBy2 (=64) のlog2値
@@ -23,10 +27,12 @@ inline constexpr size_t kMatchedFilterAlignmentShiftSizeSubBlocks =
 //   alignment_shift * num_matched_filters + window + 1
 // となる（+1 は循環バッファの境界オーバーランを防ぐ余裕）。
 // これにサブブロック長 (kBlockSize / down_sampling_factor) を掛けるとバッファ長（サンプル数）が得られる。
-inline size_t GetDownSampledBufferSize(size_t down_sampling_factor, size_t num_matched_filters) {
+// 窓幅は window_size_sub_blocks で差し替えられ、シフト間隔は常に窓幅の3/4とする。
+inline size_t GetDownSampledBufferSize(size_t down_sampling_factor, size_t num_matched_filters,
+                                       size_t window_size_sub_blocks = kMatchedFilterWindowSizeSubBlocks) {
   return kBlockSize / down_sampling_factor *
-         (kMatchedFilterAlignmentShiftSizeSubBlocks * num_matched_filters +
-          kMatchedFilterWindowSizeSubBlocks + 1);
+         (window_size_sub_blocks * 3 / 4 * num_matched_filters +
+          window_size_sub_blocks + 1);
 }
 
 // レンダー遅延バッファの必要長を算出する。
@@ -36,11 +42,34 @@ inline size_t GetDownSampledBufferSize(size_t down_sampling_factor, size_t num_m
 // バッファ長を確保する。
 inline size_t GetRenderDelayBufferSize(size_t down_sampling_factor,
                                        size_t num_matched_filters,
-                                       size_t filter_length_blocks) {
-  return GetDownSampledBufferSize(down_sampling_factor, num_matched_filters) /
+                                       size_t filter_length_blocks,
+                                       size_t window_size_sub_blocks = kMatchedFilterWindowSizeSubBlocks) {
+  return GetDownSampledBufferSize(down_sampling_factor, num_matched_filters,
+                                  window_size_sub_blocks) /
              (kBlockSize / down_sampling_factor) +
          filter_length_blocks + 1;
 }
+
+// 遅延探索範囲の設定。RenderDelayBuffer と EchoPathDelayEstimator に同じ値を渡す。
+// 探索できる最大遅延はダウンサンプル後で
+//   (num_filters * window_size_sub_blocks * 3/4 + window_size_sub_blocks) * 16 サンプル
+// となる（既定値で 5*24+32 = 152 サブブロック = 2432 サンプル、フルバンドで約608ms）。
+// フィルタを増やすほど遅延の長い経路に対応できるが、MatchedFilter の計算量も比例して増える。
+struct DelaySearchConfig {
+  size_t num_filters = 5; // マッチドフィルタの数（1以上）
+  size_t window_size_sub_blocks = kMatchedFilterWindowSizeSubBlocks; // 各フィルタの窓幅（8以上の4の倍数）
+
+  // 範囲外の値を丸めた設定を返す。窓幅は8サブブロック(128サンプル)以上かつ4の倍数に揃え、
+  // シフト間隔が整数サブブロックになり、FFT版エンジンの128サンプル窓がミラー領域に収まるようにする。
+  DelaySearchConfig Sanitized() const {
+    DelaySearchConfig c;
+    c.num_filters = std::max<size_t>(num_filters, 1);
+    c.window_size_sub_blocks = std::max<size_t>(window_size_sub_blocks / 4 * 4, 8);
+    return c;
+  }
+  // 連続するフィルタ間のシフト間隔（サブブロック数）。
+  size_t AlignmentShiftSubBlocks() const { return window_size_sub_blocks * 3 / 4; }
+};
 #pragma once
 
 #include <algorithm>
@@ -12,8 +12,18 @@
 #include <vector>
 #include <algorithm>
 #include <span>
+#include <bit>
 #include <fstream>
 #include <cstddef>
+#include <atomic>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 
 #include "aec3_common.h"
@@ -23,3 +33,4 @@
 #include "subtractor.h"
 #include "suppressor.h"
 #include "echo_remover.h"
+#include "spsc_ring.h"
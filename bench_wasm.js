@@ -0,0 +1,103 @@
+// bench_wasm.js: Compare the scalar and WASM SIMD builds of the AEC3 WASM module
+// Usage: node bench_wasm.js [render.wav] [capture.wav] [--repeat=N]
+// Build both first: make wasm wasm-simd
+
+const fs = require('fs');
+
+const kSr = 16000;
+const kBlock = 64;
+const kChunkBlocks = 5; // 20 ms per aec3_process_frames call
+
+function rd32le(buf, off) { return buf[off] | (buf[off+1]<<8) | (buf[off+2]<<16) | (buf[off+3]<<24); }
+function rd16le(buf, off) { return buf[off] | (buf[off+1]<<8); }
+
+function readWavPcm16Mono16k(path) {
+  const buf = fs.readFileSync(path);
+  if (buf.length < 44) throw new Error('Too small WAV');
+  if (buf.toString('utf8', 0, 4) !== 'RIFF' || buf.toString('utf8', 8, 12) !== 'WAVE') throw new Error('Not RIFF/WAVE');
+  let pos = 12; let sr = 0, ch = 0, bps = 0; let dataOff = 0, dataSize = 0;
+  while (pos + 8 <= buf.length) {
+    const id = rd32le(buf, pos); pos += 4; const sz = rd32le(buf, pos); pos += 4; const start = pos;
+    if (id === 0x20746d66) { // 'fmt '
+      const fmt = rd16le(buf, start+0); ch = rd16le(buf, start+2); sr = rd32le(buf, start+4); bps = rd16le(buf, start+14);
+      if (fmt !== 1 || bps !== 16) throw new Error('Expected PCM16');
+    } else if (id === 0x61746164) { // 'data'
+      dataOff = start; dataSize = sz; break;
+    }
+    pos = start + sz;
+  }
+  if (!dataOff || !dataSize) throw new Error('No data chunk');
+  if (sr !== kSr || ch !== 1) throw new Error('Expected 16k mono wav');
+  const ns = Math.floor(dataSize / 2);
+  const arr = new Int16Array(ns);
+  for (let i = 0; i < ns; i++) arr[i] = buf.readInt16LE(dataOff + i*2);
+  return arr;
+}
+
+// Run the whole recording through one module and return { seconds, out }.
+async function run(modulePath, x, y, N, repeat) {
+  const mod = await require(modulePath)();
+  const bytes = N * kBlock * 2;
+  const pRef = mod._malloc(bytes);
+  const pCap = mod._malloc(bytes);
+  const pOut = mod._malloc(bytes);
+  mod.HEAP16.set(x.subarray(0, N * kBlock), pRef >> 1);
+  mod.HEAP16.set(y.subarray(0, N * kBlock), pCap >> 1);
+  let best = Infinity;
+  for (let r = 0; r < repeat; r++) {
+    const h = mod._aec3_create();
+    const t0 = process.hrtime.bigint();
+    for (let n = 0; n < N; n += kChunkBlocks) {
+      const off = n * kBlock * 2;
+      mod._aec3_process_frames(h, pRef + off, pCap + off, pOut + off, Math.min(kChunkBlocks, N - n));
+    }
+    const seconds = Number(process.hrtime.bigint() - t0) * 1e-9;
+    best = Math.min(best, seconds);
+    mod._aec3_destroy(h);
+  }
+  const out = new Int16Array(mod.HEAP16.subarray(pOut >> 1, (pOut >> 1) + N * kBlock));
+  mod._free(pRef); mod._free(pCap); mod._free(pOut);
+  return { seconds: best, out };
+}
+
+(async () => {
+  const args = process.argv.slice(2);
+  const files = args.filter((a) => !a.startsWith('--'));
+  let repeat = 3;
+  for (const a of args) {
+    if (a.startsWith('--repeat=')) repeat = Math.max(1, parseInt(a.split('=', 2)[1], 10) || 1);
+  }
+  const renderPath = files[0] || 'counting16kLong.wav';
+  const capturePath = files[1] || 'playRecCounting16kLong.wav';
+  const x = readWavPcm16Mono16k(renderPath);
+  const y = readWavPcm16Mono16k(capturePath);
+  const N = Math.min(Math.floor(x.length / kBlock), Math.floor(y.length / kBlock));
+  const audioSeconds = N * kBlock / kSr;
+
+  const builds = [
+    { name: 'wasm', path: './dist/aec3_wasm.js' },
+    { name: 'wasm-simd', path: './dist/aec3_wasm_simd.js' },
+  ];
+  const results = [];
+  for (const b of builds) {
+    if (!fs.existsSync(b.path)) {
+      console.error(`${b.path} not found (make ${b.name})`);
+      continue;
+    }
+    const r = await run(b.path, x, y, N, repeat);
+    results.push({ ...b, ...r });
+    console.log(`${b.name.padEnd(10)} ${(r.seconds * 1000).toFixed(1).padStart(8)} ms  RTF=${(r.seconds / audioSeconds).toFixed(4)}  (${N} blocks, best of ${repeat})`);
+  }
+  if (results.length === 2) {
+    const [a, b] = results;
+    // The SIMD kernels sum in a different order, so small differences are expected.
+    let maxDiff = 0, err = 0, sig = 0;
+    for (let i = 0; i < a.out.length; i++) {
+      const d = a.out[i] - b.out[i];
+      maxDiff = Math.max(maxDiff, Math.abs(d));
+      err += d * d; sig += a.out[i] * a.out[i];
+    }
+    const snr = err > 0 ? (10 * Math.log10(sig / err)).toFixed(1) + ' dB' : 'identical';
+    console.log(`speedup ${(a.seconds / b.seconds).toFixed(2)}x, output max diff ${maxDiff}, SNR ${snr}`);
+  }
+})();
@@ -50,17 +50,88 @@ struct FftData {
   }
 };
 
+// FftDataの整列・パディング版。フィルタ係数とFFT済みレンダーデータに使う。
+// re/imを64バイト境界に置き、65ビンを72要素まで拡張してSIMDループの端数処理を不要にする。
+// 65..71番目の要素は常に0に保つ。
+struct AlignedFftData {
+  alignas(64) std::array<float, kFftLengthBy2Plus1Padded> re; // 実数部分（末尾はゼロ詰め）
+  alignas(64) std::array<float, kFftLengthBy2Plus1Padded> im; // 虚数部分（末尾はゼロ詰め）
+
+  // パディングを含めて全要素をクリアする。
+  void Clear() {
+    re.fill(0.f);
+    im.fill(0.f);
+  }
+
+  // データのパワースペクトルを計算する。
+  void Spectrum(std::span<float> power_spectrum) const {
+    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+      power_spectrum[k] = re[k] * re[k] + im[k] * im[k];
+    }
+  }
+
+  // FftDataからコピーし、パディングを0にする。
+  void CopyFrom(const FftData& src) {
+    std::copy(src.re.begin(), src.re.end(), re.begin());
+    std::copy(src.im.begin(), src.im.end(), im.begin());
+    std::fill(re.begin() + kFftLengthBy2Plus1, re.end(), 0.f);
+    std::fill(im.begin() + kFftLengthBy2Plus1, im.end(), 0.f);
+  }
+
+  // パディングを除いた65ビンをFftDataへコピーする。
+  void CopyTo(FftData* dst) const {
+    std::copy(re.begin(), re.begin() + kFftLengthBy2Plus1, dst->re.begin());
+    std::copy(im.begin(), im.begin() + kFftLengthBy2Plus1, dst->im.begin());
+  }
+
+  // 配列入力からデータをコピーし、パディングを0にする。
+  void CopyFromPackedArray(const std::array<float, kFftLength>& v) {
+    re[0] = v[0];
+    re[kFftLengthBy2] = v[1];
+    im[0] = im[kFftLengthBy2] = 0;
+    for (size_t k = 1, j = 2; k < kFftLengthBy2; ++k) {
+      re[k] = v[j++];
+      im[k] = v[j++];
+    }
+    std::fill(re.begin() + kFftLengthBy2Plus1, re.end(), 0.f);
+    std::fill(im.begin() + kFftLengthBy2Plus1, im.end(), 0.f);
+  }
+
+  // データを配列へコピーする。
+  void CopyToPackedArray(std::array<float, kFftLength>* v) const {
+    (*v)[0] = re[0];
+    (*v)[1] = re[kFftLengthBy2];
+    for (size_t k = 1, j = 2; k < kFftLengthBy2; ++k) {
+      (*v)[j++] = re[k];
+      (*v)[j++] = im[k];
+    }
+  }
+};
+
  
 
-// FftData のリングバッファと読み書きインデックスをまとめた構造体。
+// AlignedFftData のリングバッファと読み書きインデックスをまとめた構造体。
+// 先頭 mirror_size 要素の複製を末尾に持つ（ミラー領域）ので、
+// 任意の位置から mirror_size 個までは折り返しなしの連続領域として読める。
 struct FftBuffer {
-  const int size; // バッファ長（保持するFftDataの数）
-  std::vector<FftData> buffer; // FftDataのリングバッファ
+  const int size; // バッファ長（保持するAlignedFftDataの数、ミラー領域を除く）
+  const int mirror_size; // 末尾に複製する要素数
+  std::vector<AlignedFftData> buffer; // AlignedFftDataのリングバッファ（size + mirror_size 要素）
   int write = 0; // 次に書き込む位置
   int read = 0; // 次に読み出す位置
     
-  FftBuffer(size_t size) : size(static_cast<int>(size)), buffer(size) {
-    for (FftData& fft_data : buffer) fft_data.Clear();
+  FftBuffer(size_t size, size_t mirror_size = 0)
+      : size(static_cast<int>(size)),
+        mirror_size(static_cast<int>(mirror_size)),
+        buffer(size + mirror_size) {
+    for (AlignedFftData& fft_data : buffer) fft_data.Clear();
+  }
+
+  // index に書き込んだ内容をミラー領域へ複製する。書き込みのたびに呼ぶ。
+  void UpdateMirror(int index) {
+    if (index < mirror_size) {
+      buffer[size + index] = buffer[index];
+    }
   }
 
   int OffsetIndex(int index, int offset) const { return ::OffsetIndex(index, offset, size); }
@@ -70,14 +141,22 @@ struct FftBuffer {
 
  
 // 1次元スペクトル（配列）を保持するリングバッファと読み書きインデックスのラッパー。
+// sum_length > 0 のとき、read から古い側 sum_length 個のスペクトルの和 sum を逐次更新で保持する。
+// read が1つ進むごとに入るスペクトルを足して抜けるスペクトルを引く。大きなスペクトルが抜けた後の
+// 小さなビンで桁落ちしないよう和は double で持ち、さらに kSumRebuildInterval 回ごとに全長から計算し直す。read を直接動かしたとき（遅延の再設定）や
+// 窓内のスペクトルを書き換えたときは呼び出し側で RebuildSum() を呼ぶこと。
 struct SpectrumBuffer {
+  static constexpr int kSumRebuildInterval = kNumBlocksPerSecond; // 逐次和を計算し直す間隔（read の更新回数）
   const int size; // バッファ長（保持するスペクトル個数）
+  const int sum_length; // 逐次和を保持する窓長（0なら保持しない）
   std::vector<std::array<float, kFftLengthBy2Plus1>> buffer;  // 各周波数ビンのスペクトル値
+  std::array<double, kFftLengthBy2Plus1> sum{}; // read から sum_length 個のスペクトルの和
+  int updates_since_rebuild = 0; // 直近の再計算からの逐次更新回数
   int write = 0; // 次に書き込むスペクトルの位置
   int read = 0; // 次に読み出すスペクトルの位置
     
-  SpectrumBuffer(size_t size)
-      : size(static_cast<int>(size)), buffer(size) {
+  SpectrumBuffer(size_t size, size_t sum_length = 0)
+      : size(static_cast<int>(size)), sum_length(static_cast<int>(sum_length)), buffer(size) {
     for (std::array<float, kFftLengthBy2Plus1>& c : buffer) {
       std::fill(c.begin(), c.end(), 0.f);
     }
@@ -86,22 +165,66 @@ struct SpectrumBuffer {
   int IncIndex(int index) const { return ::IncIndex(index, size); }
   int OffsetIndex(int index, int offset) const { return ::OffsetIndex(index, offset, size); }
   void DecWriteIndex() { write = (write > 0 ? write - 1 : size - 1); }
-  void DecReadIndex() { read = (read > 0 ? read - 1 : size - 1); }
+  void DecReadIndex() {
+    read = (read > 0 ? read - 1 : size - 1);
+    if (sum_length == 0) {
+      return;
+    }
+    if (++updates_since_rebuild >= kSumRebuildInterval) {
+      RebuildSum();
+      return;
+    }
+    const std::array<float, kFftLengthBy2Plus1>& entering = buffer[read];
+    const std::array<float, kFftLengthBy2Plus1>& leaving = buffer[OffsetIndex(read, sum_length)];
+    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+      sum[k] = std::max(0.0, sum[k] + entering[k] - leaving[k]);
+    }
+  }
+
+  // index が逐次和の窓に含まれるかを返す。
+  bool InSumWindow(int index) const {
+    return (index - read + size) % size < sum_length;
+  }
+
+  // 逐次和を全長から計算し直す。
+  void RebuildSum() {
+    sum.fill(0.0);
+    int position = read;
+    for (int j = 0; j < sum_length; ++j) {
+      for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+        sum[k] += buffer[position][k];
+      }
+      position = IncIndex(position);
+    }
+    updates_since_rebuild = 0;
+  }
 };
 
 // ダウンサンプリング済みレンダーデータを保持するリングバッファ。
+// FftBuffer と同様に先頭 mirror_size サンプルの複製を末尾に持ち、
+// マッチドフィルタのタップ走査を折り返しなしで行えるようにする。
 struct DownsampledRenderBuffer {
-  const int size; // バッファ要素数（固定長）
-  std::vector<float> buffer; // ダウンサンプル済みレンダーパワーのリング領域
+  const int size; // バッファ要素数（固定長、ミラー領域を除く）
+  const int mirror_size; // 末尾に複製するサンプル数
+  std::vector<float> buffer; // ダウンサンプル済みレンダーパワーのリング領域（size + mirror_size 要素）
   int write = 0; // 次に書き込むインデックス
   int read = 0; // 次に読み出すインデックス
     
-  DownsampledRenderBuffer(size_t downsampled_buffer_size)
+  DownsampledRenderBuffer(size_t downsampled_buffer_size, size_t mirror_size = 0)
       : size(static_cast<int>(downsampled_buffer_size)),
-        buffer(downsampled_buffer_size, 0.f) {
+        mirror_size(static_cast<int>(mirror_size)),
+        buffer(downsampled_buffer_size + mirror_size, 0.f) {
     std::fill(buffer.begin(), buffer.end(), 0.f);
   }
 
+  // [index, index + count) に書き込んだ内容をミラー領域へ複製する。
+  void UpdateMirror(int index, int count) {
+    const int end = std::min(index + count, mirror_size);
+    for (int i = index; i < end; ++i) {
+      buffer[size + i] = buffer[i];
+    }
+  }
+
   int OffsetIndex(int index, int offset) const { return ::OffsetIndex(index, offset, size); }
   void UpdateWriteIndex(int offset) { write = OffsetIndex(write, offset); }
   void UpdateReadIndex(int offset) { read = OffsetIndex(read, offset); }
@@ -113,13 +236,16 @@ struct RenderBuffer {
   const BlockBuffer* const block_buffer_; // 時間領域レンダーブロックのリングバッファ
   const SpectrumBuffer* const spectrum_buffer_; // レンダースペクトルのリングバッファ
   const FftBuffer* const fft_buffer_; // FFT済みレンダーデータのリングバッファ
+  const std::vector<uint8_t>* const render_activity_; // ブロックごとのレンダー有音フラグ（スペクトルバッファと同じ添字）
     
   RenderBuffer(BlockBuffer* block_buffer,
                SpectrumBuffer* spectrum_buffer,
-               FftBuffer* fft_buffer)
+               FftBuffer* fft_buffer,
+               const std::vector<uint8_t>* render_activity)
       : block_buffer_(block_buffer),
         spectrum_buffer_(spectrum_buffer),
-        fft_buffer_(fft_buffer) {}
+        fft_buffer_(fft_buffer),
+        render_activity_(render_activity) {}
 
   // 指定オフセットの時間領域ブロックを取得する。
   const Block& GetBlock(int buffer_offset_blocks) const {
@@ -136,8 +262,18 @@ struct RenderBuffer {
     return spectrum_buffer_->buffer[position];
   }
 
-  // FFT済みレンダーデータの全要素をspanで参照する。
-  std::span<const FftData> GetFftBuffer() const { return fft_buffer_->buffer; }
+  // FFT済みレンダーデータの全要素をspanで参照する（ミラー領域は含まない）。
+  std::span<const AlignedFftData> GetFftBuffer() const {
+    return std::span<const AlignedFftData>(fft_buffer_->buffer).first(fft_buffer_->size);
+  }
+
+  // position から num_partitions 個のFFT済みレンダーデータを連続領域として参照する。
+  // num_partitions はFftBufferのミラー長以下であること。
+  std::span<const AlignedFftData> GetFftPartitions(size_t position,
+                                                   size_t num_partitions) const {
+    return std::span<const AlignedFftData>(fft_buffer_->buffer)
+        .subspan(position, num_partitions);
+  }
 
   // 現在の読み出し位置を返す。
   size_t Position() const {
@@ -145,8 +281,15 @@ struct RenderBuffer {
   }
 
   // 指定数のスペクトルを合計してレンダーパワーを算出する。
+  // スペクトルバッファが同じ窓長の逐次和を保持していればそれを返す。
   void SpectralSum(size_t num_spectra,
                    std::array<float, kFftLengthBy2Plus1>* X2) const {
+    if (static_cast<int>(num_spectra) == spectrum_buffer_->sum_length) {
+      for (size_t k = 0; k < X2->size(); ++k) {
+        (*X2)[k] = static_cast<float>(spectrum_buffer_->sum[k]);
+      }
+      return;
+    }
     X2->fill(0.f);
     int position = spectrum_buffer_->read;
     for (size_t j = 0; j < num_spectra; ++j) {
@@ -161,4 +304,16 @@ struct RenderBuffer {
   // スペクトルバッファへの参照を返す。
   const SpectrumBuffer& GetSpectrumBuffer() const { return *spectrum_buffer_; }
 
+  // 読み出し位置から古い側 num_blocks ブロックのいずれかに有音のレンダーがあるかを返す。
+  bool ActiveRender(size_t num_blocks) const {
+    int position = spectrum_buffer_->read;
+    for (size_t j = 0; j < num_blocks; ++j) {
+      if ((*render_activity_)[position]) {
+        return true;
+      }
+      position = spectrum_buffer_->IncIndex(position);
+    }
+    return false;
+  }
+
 };
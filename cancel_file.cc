@@ -1,96 +1,314 @@
 // Offline comparator: feed two WAVs (render x, capture y) into AEC3 and print metrics per block
+// Batch mode: process every render/capture pair of a manifest in parallel and print a summary table
 #include "all.h"
+#include "multi_session.h"
 
-struct Wav {
-  int sr = 0;
-  int ch = 0;
-  std::vector<int16_t> samples;
-};
+#include <cerrno>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// WAV reader that maps the file instead of loading it: blocks are read straight from the mapped
+// data chunk as the kernel pages it in, and Release() drops the pages already processed,
+// so memory use does not depend on the file length.
+struct WavReader {
+  int sr_ = 0;
+  int ch_ = 0;
+  const int16_t* samples_ = nullptr; // PCM16 data inside the mapping
+  size_t num_samples_ = 0;
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
 
-static uint32_t rd32le(const uint8_t* p){ return p[0] | (p[1]<<8) | (p[2]<<16) | (p[3]<<24); }
-static uint16_t rd16le(const uint8_t* p){ return p[0] | (p[1]<<8); }
-
-static bool read_wav_pcm16(const std::string& path, Wav* out){
-  std::ifstream f(path, std::ios::binary);
-  if (!f) return false;
-  std::vector<uint8_t> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-  if (buf.size() < 44) return false;
-  if (std::memcmp(buf.data(), "RIFF",4) || std::memcmp(buf.data()+8,"WAVE",4)) return false;
-  size_t pos = 12; int sr=0,ch=0,bps=0; size_t data_off=0,data_size=0;
-  while (pos + 8 <= buf.size()){
-    uint32_t id = rd32le(&buf[pos]); pos+=4; uint32_t sz = rd32le(&buf[pos]); pos+=4; size_t start=pos;
-    if (id == 0x20746d66){ // 'fmt '
-      uint16_t fmt = rd16le(&buf[start+0]); ch = rd16le(&buf[start+2]); sr = rd32le(&buf[start+4]); bps = rd16le(&buf[start+14]);
-      if (fmt != 1 || bps != 16) return false;
-    } else if (id == 0x61746164){ // 'data'
-      data_off = start; data_size = sz; break;
+  WavReader() = default;
+  WavReader(const WavReader&) = delete;
+  WavReader& operator=(const WavReader&) = delete;
+  ~WavReader(){ if (map_) munmap(map_, map_size_); }
+
+  bool Open(const std::string& path){
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 44){ close(fd); return false; }
+    map_size_ = static_cast<size_t>(st.st_size);
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED){ map_ = nullptr; return false; }
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+    const uint8_t* buf = static_cast<const uint8_t*>(map_);
+    if (std::memcmp(buf, "RIFF",4) || std::memcmp(buf+8,"WAVE",4)) return false;
+    size_t pos = 12; int bps=0; size_t data_off=0,data_size=0;
+    while (pos + 8 <= map_size_){
+      uint32_t id = rd32le(&buf[pos]); pos+=4; uint32_t sz = rd32le(&buf[pos]); pos+=4; size_t start=pos;
+      if (id == 0x20746d66){ // 'fmt '
+        if (start + 16 > map_size_) return false;
+        uint16_t fmt = rd16le(&buf[start+0]); ch_ = rd16le(&buf[start+2]); sr_ = rd32le(&buf[start+4]); bps = rd16le(&buf[start+14]);
+        if (fmt != 1 || bps != 16) return false;
+      } else if (id == 0x61746164){ // 'data'
+        // A size of 0 or 0xFFFFFFFF means the writer has not patched it yet (see WavWriter::Close):
+        // read such a file to the end of the mapping, like any size that runs past the end.
+        data_off = start;
+        data_size = (sz == 0 || sz == 0xFFFFFFFFu) ? map_size_ - start : std::min<size_t>(sz, map_size_ - start);
+        break;
+      }
+      pos = start + sz + (sz & 1);
     }
-    pos = start + sz;
+    if (!data_off || !data_size) return false;
+    samples_ = reinterpret_cast<const int16_t*>(&buf[data_off]);
+    num_samples_ = data_size/2;
+    return true;
+  }
+
+  // Drop the already processed pages (those before sample n) from memory; they are not read again.
+  void Release(size_t n) const {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t bytes = (reinterpret_cast<const uint8_t*>(samples_ + n) - static_cast<const uint8_t*>(map_)) / page * page;
+    if (bytes) madvise(map_, bytes, MADV_DONTNEED);
   }
-  if (!data_off || !data_size) return false;
-  out->sr = sr; out->ch = ch; size_t ns = data_size/2; out->samples.resize(ns);
-  const int16_t* p = reinterpret_cast<const int16_t*>(&buf[data_off]);
-  for (size_t i=0;i<ns;i++) out->samples[i] = p[i];
-  return true;
+
+  static uint32_t rd32le(const uint8_t* p){ return p[0] | (p[1]<<8) | (p[2]<<16) | (p[3]<<24); }
+  static uint16_t rd16le(const uint8_t* p){ return p[0] | (p[1]<<8); }
+};
+
+// PCM16 mono 16kHz WAV writer that streams samples to the file: the header is written with zero sizes
+// first and patched in Close(), so memory use stays constant whatever the output length.
+struct WavWriter {
+  std::ofstream f_;
+  uint32_t data_bytes_ = 0;
+
+  bool Open(const std::string& path){
+    f_.open(path, std::ios::binary);
+    if (!f_) return false;
+    const uint32_t sr = 16000;
+    const uint16_t ch = 1;
+    const uint16_t bps = 16;
+    const uint32_t byte_rate = sr * ch * (bps/8);
+    const uint16_t block_align = ch * (bps/8);
+    const uint32_t zero = 0;
+    // RIFF header
+    f_.write("RIFF",4);
+    f_.write(reinterpret_cast<const char*>(&zero),4); // 36 + data size, patched in Close()
+    f_.write("WAVE",4);
+    // fmt chunk
+    f_.write("fmt ",4);
+    uint32_t fmt_size = 16; f_.write(reinterpret_cast<const char*>(&fmt_size),4);
+    uint16_t audio_format = 1; f_.write(reinterpret_cast<const char*>(&audio_format),2);
+    f_.write(reinterpret_cast<const char*>(&ch),2);
+    f_.write(reinterpret_cast<const char*>(&sr),4);
+    f_.write(reinterpret_cast<const char*>(&byte_rate),4);
+    f_.write(reinterpret_cast<const char*>(&block_align),2);
+    f_.write(reinterpret_cast<const char*>(&bps),2);
+    // data chunk
+    f_.write("data",4);
+    f_.write(reinterpret_cast<const char*>(&zero),4); // data size, patched in Close()
+    return static_cast<bool>(f_);
+  }
+
+  void Write(const int16_t* samples, size_t n){
+    f_.write(reinterpret_cast<const char*>(samples), n * sizeof(int16_t));
+    data_bytes_ += static_cast<uint32_t>(n * sizeof(int16_t));
+  }
+
+  // Patch the RIFF and data sizes and close the file.
+  bool Close(){
+    const uint32_t file_size_minus_8 = 36 + data_bytes_;
+    f_.seekp(4); f_.write(reinterpret_cast<const char*>(&file_size_minus_8),4);
+    f_.seekp(40); f_.write(reinterpret_cast<const char*>(&data_bytes_),4);
+    f_.close();
+    return !f_.fail();
+  }
+};
+
+// Processing options shared by the single-pair and batch modes
+struct CancelOptions {
+  bool enable_linear = true, enable_nonlinear = true, fft_delay = false, render_gating = true;
+  DelaySearchConfig delay_config; // --delay-filters: number of matched filters, --delay-window: window size in sub-blocks
+  bool delay_tracking = false; size_t full_search_interval = 25; // --delay-tracking=N: full search interval in blocks while tracking
+};
+
+static void parse_option(const std::string& a, CancelOptions* o){
+  if(a=="--no-linear") o->enable_linear=false; else if(a=="--no-nonlinear") o->enable_nonlinear=false; else if(a=="--fft-delay") o->fft_delay=true;
+  else if(a.rfind("--delay-filters=",0)==0) o->delay_config.num_filters = std::strtoul(a.c_str()+std::strlen("--delay-filters="), nullptr, 10);
+  else if(a.rfind("--delay-window=",0)==0) o->delay_config.window_size_sub_blocks = std::strtoul(a.c_str()+std::strlen("--delay-window="), nullptr, 10);
+  else if(a=="--no-render-gating") o->render_gating=false;
+  else if(a=="--delay-tracking") o->delay_tracking=true;
+  else if(a.rfind("--delay-tracking=",0)==0){ o->delay_tracking=true; o->full_search_interval = std::strtoul(a.c_str()+std::strlen("--delay-tracking="), nullptr, 10); }
 }
 
-int main(int argc, char** argv){
-  if (argc < 3){ std::fprintf(stderr, "Usage: %s <render.wav> <capture.wav> [--no-linear] [--no-nonlinear]\n", argv[0]); return 1; }
-  bool enable_linear = true, enable_nonlinear = true;
-  for (int i=3;i<argc;i++){ std::string a(argv[i]); if(a=="--no-linear") enable_linear=false; else if(a=="--no-nonlinear") enable_nonlinear=false; }
-  Wav x, y;
-  if (!read_wav_pcm16(argv[1], &x) || !read_wav_pcm16(argv[2], &y)){ std::fprintf(stderr, "Failed to read wavs\n"); return 1; }
-  if (x.sr!=16000 || y.sr!=16000 || x.ch!=1 || y.ch!=1){ std::fprintf(stderr, "Expected 16k mono wavs\n"); }
-  size_t N = std::min(x.samples.size(), y.samples.size()) / kBlockSize;
-  RenderDelayBuffer render_buffer;
-  EchoPathDelayEstimator delay_estimator;
-  EchoRemover echo_remover;
-  int estimated_delay_blocks = -1;
-  echo_remover.SetProcessingModes(enable_linear, enable_nonlinear);
+// Per-file results for the batch summary
+struct CancelSummary {
+  size_t blocks = 0;
+  double erle_db = 0.0; // 10*log10(capture energy / output energy) over the whole file
+  int delay_blocks = -1; // estimated delay at the end of the file (-1: not found)
+  double convergence_s = -1.0; // when the linear filter converged, see kConvergence* below (-1: never)
+  double process_s = 0.0; // wall-clock processing time
+};
+
+// Convergence time of the linear filter, measured on the signal: e2 and y2 (linear error and capture
+// power) are smoothed over the blocks with far-end activity, and the filter counts as converged at the
+// first block of the first run of kConvergenceBlocks such blocks whose smoothed y2/e2 stays at or above
+// kConvergenceErleDb. Blocks without far-end activity neither extend nor break the run.
+static constexpr double kConvergenceErleDb = 6.0;
+static constexpr size_t kConvergenceBlocks = 50; // 200 ms
+static constexpr double kConvergenceSmoothing = 0.1; // per block, about 40 ms
+
+// Run one render/capture pair through a fresh canceller, streaming the output to out block by block.
+// If log is set, print the per-block metrics to it.
+static CancelSummary cancel_pair(const WavReader& x, const WavReader& y, const CancelOptions& o, WavWriter* out, FILE* log){
+  const auto start = std::chrono::steady_clock::now();
+  CancelSummary summary;
+  size_t N = std::min(x.num_samples_, y.num_samples_) / kBlockSize;
+  EchoCancellerSession session(o.delay_config);
+  session.echo_remover_.SetProcessingModes(o.enable_linear, o.enable_nonlinear);
+  session.echo_remover_.SetRenderGating(o.render_gating);
+  session.delay_estimator_.SetFftMatchedFilter(o.fft_delay);
+  session.delay_estimator_.SetLowPowerTracking(o.delay_tracking, o.full_search_interval);
   Block render_block;
   Block capture_block;
-  std::vector<int16_t> processed;
-  processed.resize(N * kBlockSize);
+  std::array<int16_t, kBlockSize> processed;
+  double capture_energy = 0.0, output_energy = 0.0;
+  double y2_smoothed = 0.0, e2_smoothed = 0.0;
+  size_t converged_run = 0, run_start = 0; // active blocks at or above kConvergenceErleDb in a row, and the first of them
+  const double convergence_ratio = std::pow(10.0, kConvergenceErleDb / 10.0);
   for (size_t n=0;n<N;n++){
-    CopyFromPcm16(&x.samples[n * kBlockSize], &render_block);
-    CopyFromPcm16(&y.samples[n * kBlockSize], &capture_block);
-    render_buffer.Insert(render_block);
-    ProcessCaptureBlock(&render_buffer, &delay_estimator, &echo_remover,
-                        &estimated_delay_blocks, &capture_block);
-    CopyToPcm16(capture_block, &processed[n * kBlockSize]);
-    const EchoRemover::LastMetrics& erm = echo_remover.last_metrics_;
-    int dblk = estimated_delay_blocks;
+    const int16_t* capture = &y.samples_[n * kBlockSize];
+    CopyFromPcm16(&x.samples_[n * kBlockSize], &render_block);
+    CopyFromPcm16(capture, &capture_block);
+    session.ProcessBlock(render_block, &capture_block);
+    CopyToPcm16(capture_block, processed.data());
+    out->Write(processed.data(), kBlockSize);
+    for (size_t i=0;i<kBlockSize;i++){
+      const double c = capture[i], e = processed[i];
+      capture_energy += c * c; output_energy += e * e;
+    }
+    if ((n + 1) % 4096 == 0){ x.Release((n + 1) * kBlockSize); y.Release((n + 1) * kBlockSize); } // about every 16 s
+    const EchoRemover::LastMetrics& erm = session.echo_remover_.last_metrics_;
+    int dblk = session.estimated_delay_blocks_;
+    if (summary.convergence_s < 0.0 && erm.valid && erm.render_active){
+      y2_smoothed += kConvergenceSmoothing * (erm.y2 - y2_smoothed);
+      e2_smoothed += kConvergenceSmoothing * (erm.e2 - e2_smoothed);
+      converged_run = y2_smoothed > 0.0 && y2_smoothed >= convergence_ratio * e2_smoothed ? converged_run + 1 : 0;
+      if (converged_run == 1) run_start = n;
+      if (converged_run == kConvergenceBlocks) summary.convergence_s = run_start * kBlockSize / 16000.0;
+    }
+    if (!log) continue;
     float dms = (dblk >= 0) ? (dblk * (1000.0f * static_cast<float>(kBlockSize) / 16000.0f)) : -1.0f; // 64 samples @16kHz = 4ms per block
     float ratio = (erm.y2 > 0.f) ? (erm.e2 / erm.y2) : 0.f;
-    std::printf("block=%zu y2=%.6g e2=%.6g e2_over_y2=%.6g erle_avg=%.6g linear_usable=%d est_delay_blocks=%d est_delay_ms=%.6g\n",
-                n, erm.y2, erm.e2, ratio, erm.erle_avg, erm.linear_usable?1:0, dblk, dms);
+    std::fprintf(log, "block=%zu y2=%.6g e2=%.6g e2_over_y2=%.6g erle_avg=%.6g linear_usable=%d est_delay_blocks=%d est_delay_ms=%.6g\n",
+                 n, erm.y2, erm.e2, ratio, erm.erle_avg, erm.linear_usable?1:0, dblk, dms);
   }
-  // Save processed signal as processed.wav (PCM16 mono 16kHz)
-  const uint32_t sr = 16000;
-  const uint16_t ch = 1;
-  const uint16_t bps = 16;
-  const uint32_t data_bytes = static_cast<uint32_t>(processed.size() * sizeof(int16_t));
-  const uint32_t byte_rate = sr * ch * (bps/8);
-  const uint16_t block_align = ch * (bps/8);
-  std::ofstream wf("processed.wav", std::ios::binary);
-  if (wf){
-    // RIFF header
-    wf.write("RIFF",4);
-    uint32_t file_size_minus_8 = 36 + data_bytes; wf.write(reinterpret_cast<const char*>(&file_size_minus_8),4);
-    wf.write("WAVE",4);
-    // fmt chunk
-    wf.write("fmt ",4);
-    uint32_t fmt_size = 16; wf.write(reinterpret_cast<const char*>(&fmt_size),4);
-    uint16_t audio_format = 1; wf.write(reinterpret_cast<const char*>(&audio_format),2);
-    wf.write(reinterpret_cast<const char*>(&ch),2);
-    wf.write(reinterpret_cast<const char*>(&sr),4);
-    wf.write(reinterpret_cast<const char*>(&byte_rate),4);
-    wf.write(reinterpret_cast<const char*>(&block_align),2);
-    wf.write(reinterpret_cast<const char*>(&bps),2);
-    // data chunk
-    wf.write("data",4);
-    wf.write(reinterpret_cast<const char*>(&data_bytes),4);
-    wf.write(reinterpret_cast<const char*>(processed.data()), data_bytes);
+  summary.blocks = N;
+  summary.erle_db = 10.0 * std::log10((capture_energy + 1e-9) / (output_energy + 1e-9));
+  summary.delay_blocks = session.estimated_delay_blocks_;
+  summary.process_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return summary;
+}
+
+// One manifest line: "<render.wav> <capture.wav> [output.wav]"
+struct BatchJob {
+  std::string render, capture, output;
+  CancelSummary summary;
+  std::string error; // empty on success
+};
+
+// Process every pair of the manifest with `jobs` threads (one independent canceller per file),
+// write the outputs to out_dir and print the summary table (also saved as out_dir/summary.tsv).
+static int run_batch(const std::string& manifest, const std::string& out_dir, size_t jobs, const CancelOptions& o){
+  std::ifstream mf(manifest);
+  if (!mf){ std::fprintf(stderr, "Failed to read manifest %s\n", manifest.c_str()); return 1; }
+  std::vector<BatchJob> batch;
+  std::string line;
+  while (std::getline(mf, line)){
+    std::istringstream ls(line);
+    BatchJob job;
+    if (!(ls >> job.render) || job.render[0] == '#') continue;
+    if (!(ls >> job.capture)){ std::fprintf(stderr, "Manifest line without capture: %s\n", line.c_str()); return 1; }
+    // Output name defaults to the capture file name; give a third column when names collide
+    if (!(ls >> job.output)) job.output = job.capture.substr(job.capture.find_last_of('/') + 1);
+    job.output = out_dir + "/" + job.output;
+    batch.push_back(job);
   }
+  for (size_t i=0;i<batch.size();i++) for (size_t j=0;j<i;j++){
+    if (batch[i].output == batch[j].output){ std::fprintf(stderr, "Duplicate output %s (add an output name column)\n", batch[i].output.c_str()); return 1; }
+  }
+  if (mkdir(out_dir.c_str(), 0755) != 0 && errno != EEXIST){ std::fprintf(stderr, "Failed to create %s\n", out_dir.c_str()); return 1; }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next{0};
+  auto worker = [&]{
+    for (size_t i = next.fetch_add(1); i < batch.size(); i = next.fetch_add(1)){
+      BatchJob& job = batch[i];
+      WavReader x, y;
+      WavWriter out;
+      if (!x.Open(job.render) || !y.Open(job.capture)){ job.error = "read failed"; continue; }
+      if (x.sr_!=16000 || y.sr_!=16000 || x.ch_!=1 || y.ch_!=1){ job.error = "not 16k mono"; continue; }
+      if (!out.Open(job.output)){ job.error = "write failed"; continue; }
+      job.summary = cancel_pair(x, y, o, &out, nullptr);
+      if (!out.Close()) job.error = "write failed";
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t t=0;t<std::min(jobs, batch.size());t++) threads.emplace_back(worker);
+  for (std::thread& t : threads) t.join();
+  const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::FILE* tsv = std::fopen((out_dir + "/summary.tsv").c_str(), "w");
+  if (tsv) std::fprintf(tsv, "# convergence_s: start of the first run of %zu blocks with far-end activity whose smoothed capture/linear-error power ratio stays >= %.0f dB (-1: never)\n",
+                        kConvergenceBlocks, kConvergenceErleDb);
+  if (tsv) std::fprintf(tsv, "capture\toutput\taudio_s\terle_db\tdelay_ms\tconvergence_s\trtf\terror\n");
+  std::printf("%-40s %9s %8s %9s %7s %7s\n", "capture", "audio_s", "erle_db", "delay_ms", "conv_s", "rtf");
+  double audio_total = 0.0; size_t failed = 0;
+  for (const BatchJob& job : batch){
+    const CancelSummary& r = job.summary;
+    const double audio_s = r.blocks * kBlockSize / 16000.0;
+    const double delay_ms = r.delay_blocks >= 0 ? r.delay_blocks * (1000.0 * kBlockSize / 16000.0) : -1.0;
+    const double rtf = audio_s > 0.0 ? r.process_s / audio_s : 0.0;
+    audio_total += audio_s;
+    if (!job.error.empty()){
+      failed++;
+      std::printf("%-40s %s\n", job.capture.c_str(), job.error.c_str());
+    } else {
+      std::printf("%-40s %9.2f %8.2f %9.1f %7.2f %7.4f\n", job.capture.c_str(), audio_s, r.erle_db, delay_ms, r.convergence_s, rtf);
+    }
+    if (tsv) std::fprintf(tsv, "%s\t%s\t%.3f\t%.3f\t%.1f\t%.3f\t%.5f\t%s\n", job.capture.c_str(), job.output.c_str(),
+                          audio_s, r.erle_db, delay_ms, r.convergence_s, rtf, job.error.c_str());
+  }
+  if (tsv) std::fclose(tsv);
+  std::printf("%zu files (%zu failed), %.1f s audio in %.2f s with %zu threads (%.1fx real time)\n",
+              batch.size(), failed, audio_total, wall_s, threads.size(), wall_s > 0.0 ? audio_total / wall_s : 0.0);
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+  const char* usage = "Usage: %s <render.wav> <capture.wav> [options]\n"
+                      "       %s --batch=<manifest> --out-dir=<dir> [--jobs=N] [options]\n"
+                      "Options: [--no-linear] [--no-nonlinear] [--fft-delay] [--delay-filters=N] [--delay-window=N] [--delay-tracking[=N]] [--no-render-gating]\n";
+  if (argc < 2){ std::fprintf(stderr, usage, argv[0], argv[0]); return 1; }
+  CancelOptions options;
+  std::string manifest, out_dir = "processed";
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+  const bool batch = std::strncmp(argv[1], "--batch=", 8) == 0;
+  if (!batch && argc < 3){ std::fprintf(stderr, usage, argv[0], argv[0]); return 1; }
+  for (int i=batch?1:3;i<argc;i++){
+    std::string a(argv[i]);
+    if(a.rfind("--batch=",0)==0) manifest = a.substr(std::strlen("--batch="));
+    else if(a.rfind("--out-dir=",0)==0) out_dir = a.substr(std::strlen("--out-dir="));
+    else if(a.rfind("--jobs=",0)==0) jobs = std::max<size_t>(1, std::strtoul(a.c_str()+std::strlen("--jobs="), nullptr, 10));
+    else parse_option(a, &options);
+  }
+  if (batch) return run_batch(manifest, out_dir, jobs, options);
+
+  WavReader x, y;
+  if (!x.Open(argv[1]) || !y.Open(argv[2])){ std::fprintf(stderr, "Failed to read wavs\n"); return 1; }
+  if (x.sr_!=16000 || y.sr_!=16000 || x.ch_!=1 || y.ch_!=1){ std::fprintf(stderr, "Expected 16k mono wavs\n"); }
+  // Save processed signal as processed.wav (PCM16 mono 16kHz), written as it is produced
+  WavWriter out;
+  if (!out.Open("processed.wav")){ std::fprintf(stderr, "Failed to open processed.wav\n"); return 1; }
+  cancel_pair(x, y, options, &out, stdout);
+  if (!out.Close()){ std::fprintf(stderr, "Failed to write processed.wav\n"); return 1; }
   return 0;
 }
@@ -80,31 +80,34 @@ function writeWavPcm16Mono16k(path, samples) {
   const h = mod._aec3_create();
   mod._aec3_set_modes(h, enableLinear ? 1 : 0, enableNonlinear ? 1 : 0);
 
-  const bytes = kBlock * 2;
+  // render/capture/output live in the WASM heap for the whole run; aec3_process_frames
+  // reads and writes them in place, kChunkBlocks blocks (20 ms) per call.
+  const kChunkBlocks = 5;
+  const bytes = N * kBlock * 2;
   const pRef = mod._malloc(bytes);
   const pCap = mod._malloc(bytes);
   const pOut = mod._malloc(bytes);
+  mod.HEAP16.set(x.subarray(0, N * kBlock), pRef >> 1);
+  mod.HEAP16.set(y.subarray(0, N * kBlock), pCap >> 1);
 
-  const processed = new Int16Array(N * kBlock);
-
-  for (let n = 0; n < N; n++) {
-    const ref = x.subarray(n*kBlock, (n+1)*kBlock);
-    const cap = y.subarray(n*kBlock, (n+1)*kBlock);
-    mod.HEAP16.set(ref, pRef >> 1);
-    mod.HEAP16.set(cap, pCap >> 1);
-    mod._aec3_analyze(h, pRef);
-    mod._aec3_process(h, pCap, pOut);
-    const out = mod.HEAP16.subarray(pOut >> 1, (pOut >> 1) + kBlock);
-    processed.set(out, n*kBlock);
-
-    // Simple metrics similar in spirit to C++ version
-    let y2 = 0, e2 = 0;
-    for (let i = 0; i < kBlock; i++) { const yy = cap[i]; const ee = out[i]; y2 += yy*yy; e2 += ee*ee; }
-    const ratio = y2 > 0 ? (e2 / y2) : 0;
+  for (let n = 0; n < N; n += kChunkBlocks) {
+    const nb = Math.min(kChunkBlocks, N - n);
+    const off = n * kBlock * 2;
+    mod._aec3_process_frames(h, pRef + off, pCap + off, pOut + off, nb);
     const dblk = mod._aec3_get_estimated_delay_blocks(h);
     const dms = dblk >= 0 ? (dblk * (1000.0 * kBlock / kSr)) : -1;
-    console.log(`block=${n} y2=${y2.toExponential()} e2=${e2.toExponential()} e2_over_y2=${ratio.toExponential()} est_delay_blocks=${dblk} est_delay_ms=${dms.toFixed(3)}`);
+    // HEAP16 is re-read after each call in case the heap was grown
+    const cap = mod.HEAP16.subarray((pCap + off) >> 1, ((pCap + off) >> 1) + nb * kBlock);
+    const out = mod.HEAP16.subarray((pOut + off) >> 1, ((pOut + off) >> 1) + nb * kBlock);
+    for (let b = 0; b < nb; b++) {
+      // Simple metrics similar in spirit to C++ version (delay is sampled once per chunk)
+      let y2 = 0, e2 = 0;
+      for (let i = b * kBlock; i < (b + 1) * kBlock; i++) { const yy = cap[i]; const ee = out[i]; y2 += yy*yy; e2 += ee*ee; }
+      const ratio = y2 > 0 ? (e2 / y2) : 0;
+      console.log(`block=${n + b} y2=${y2.toExponential()} e2=${e2.toExponential()} e2_over_y2=${ratio.toExponential()} est_delay_blocks=${dblk} est_delay_ms=${dms.toFixed(3)}`);
+    }
   }
+  const processed = mod.HEAP16.subarray(pOut >> 1, (pOut >> 1) + N * kBlock);
 
   writeWavPcm16Mono16k('processed.wav', processed);
 
@@ -59,14 +59,6 @@ function writeWavPcm16Mono16k(path, samples) {
   fs.writeFileSync(path, out);
 }
 
-function pushArray(dstArr, src) { for (let i = 0; i < src.length; i++) dstArr.push(src[i]|0); }
-function popBlockI16(arr) {
-  if (arr.length < kBlock) return null;
-  const out = new Int16Array(kBlock);
-  for (let i = 0; i < kBlock; i++) out[i] = arr.shift();
-  return out;
-}
-
 function toInt16Array(x) {
   if (!x) return new Int16Array();
   if (ArrayBuffer.isView(x)) {
@@ -81,6 +73,30 @@ function toInt16Array(x) {
   return out;
 }
 
+// PortAudio: PANode build (N-API / V8) if built, else the prebuilt PAmac.node
+function loadPortAudio() {
+  for (const p of ['./PANode/build/Release/PA_napi.node', './PANode/build/Release/PA.node']) {
+    try { return require(p); } catch {}
+  }
+  if (process.platform === 'darwin') return require('./PAmac.node');
+  return null;
+}
+
+// Move whole blocks of newly recorded mic samples (at most maxSamples) to HEAP16[dst...] and return the count.
+function readMic(PortAudio, mod, dst, maxSamples) {
+  if (typeof PortAudio.readRecordedSamples === 'function') {
+    // the native side copies straight into the WASM heap
+    return PortAudio.readRecordedSamples(mod.HEAP16.subarray(dst, dst + maxSamples), kBlock);
+  }
+  const recArr = toInt16Array(PortAudio.getRecordedSamples());
+  let n = Math.min(recArr.length, maxSamples);
+  n -= n % kBlock;
+  mod.HEAP16.set(recArr.subarray(0, n), dst);
+  // what was not taken stays in the PAmac buffer
+  if (n > 0 && typeof PortAudio.discardRecordedSamples === 'function') PortAudio.discardRecordedSamples(n);
+  return n;
+}
+
 (async () => {
   const args = process.argv.slice(2);
   if (args.length < 1) {
@@ -99,10 +115,9 @@ function toInt16Array(x) {
   const far = readWavPcm16Mono16k(renderPath);
   const totalBlocks = Math.ceil(far.length / kBlock);
 
-  let PortAudio = null;
-  if (process.platform === 'darwin') PortAudio = require('./PAmac.node');
-  else {
-    console.error('Only macOS (PAmac.node) is supported.');
+  const PortAudio = loadPortAudio();
+  if (!PortAudio) {
+    console.error('PortAudio binding not found (build PANode, or use PAmac.node on macOS).');
     process.exit(1);
   }
 
@@ -115,101 +130,96 @@ function toInt16Array(x) {
   assert(h !== 0);
   mod._aec3_set_modes(h, enableLinear ? 1 : 0, enableNonlinear ? 1 : 0);
 
-  const bytes = kBlock * 2;
-  const pRef = mod._malloc(bytes);
-  const pCap = mod._malloc(bytes);
-  const pOut = mod._malloc(bytes);
-
-  let recQ = [];
-  let refQ = [];
-  let processed = [];
-  let playIdx = 0;
+  // The far-end signal, the mic and the output stay in the WASM heap for the whole run:
+  // the mic is read straight into it and aec3_process_frames runs on it in place.
+  // Indices below are HEAP16 indices; always go through mod.HEAP16 (the heap may grow).
+  const totalSamples = totalBlocks * kBlock;
+  const pFar = mod._malloc(totalSamples * 2);
+  const pCap = mod._malloc(totalSamples * 2);
+  const pOut = mod._malloc(totalSamples * 2);
+  const farBase = pFar >> 1, capBase = pCap >> 1, outBase = pOut >> 1;
+  mod.HEAP16.set(far, farBase);
+  mod.HEAP16.fill(0, farBase + far.length, farBase + totalSamples);
+  // older PAmac.node ignores view offsets, so it gets each block copied into a whole array
+  const playViews = typeof PortAudio.readRecordedSamples === 'function';
+  const playBlock = new Int16Array(kBlock);
   let blocksSent = 0;
   let donePlaying = false;
+  let capSamples = 0;
   let refBlocksProcessed = 0;
   let finished = false;
-  let blockCounter = 0;
   let postPlaybackTicks = 0;
   const maxPostPlaybackTicks = kBlocksPerSec * 2;
 
   function shutdown() {
     if (typeof PortAudio.stopMic === 'function') PortAudio.stopMic();
     if (typeof PortAudio.stopSpeaker === 'function') PortAudio.stopSpeaker();
-    mod._free(pRef); mod._free(pCap); mod._free(pOut);
-    mod._aec3_destroy(h);
   }
 
+  // Process every captured block whose far-end block has been played, in one call.
   function processAvailableBlocks() {
-    let processedAny = false;
-    while (refQ.length >= kBlock && recQ.length >= kBlock) {
-      const ref = popBlockI16(refQ);
-      const cap = popBlockI16(recQ);
-      mod.HEAP16.set(ref, pRef >> 1);
-      mod.HEAP16.set(cap, pCap >> 1);
-      mod._aec3_analyze(h, pRef);
-      mod._aec3_process(h, pCap, pOut);
-      const outView = mod.HEAP16.subarray(pOut >> 1, (pOut >> 1) + kBlock);
-      const outBlock = new Int16Array(kBlock);
-      outBlock.set(outView);
-      for (let i = 0; i < kBlock; i++) processed.push(outBlock[i]);
-
+    const n = Math.min(Math.floor(capSamples / kBlock), blocksSent) - refBlocksProcessed;
+    if (n <= 0) return false;
+    const off = refBlocksProcessed * kBlock;
+    mod._aec3_process_frames(h, pFar + off * 2, pCap + off * 2, pOut + off * 2, n);
+    const dblk = mod._aec3_get_estimated_delay_blocks(h);
+    const dms = dblk >= 0 ? (dblk * (1000.0 * kBlock / kSr)) : -1;
+    // HEAP16 is re-read after each call in case the heap was grown
+    const cap = mod.HEAP16.subarray(capBase + off, capBase + off + n * kBlock);
+    const out = mod.HEAP16.subarray(outBase + off, outBase + off + n * kBlock);
+    for (let b = 0; b < n; b++) {
+      // the delay is sampled once per call
       let y2 = 0, e2 = 0;
-      for (let i = 0; i < kBlock; i++) { const yy = cap[i]; const ee = outBlock[i]; y2 += yy*yy; e2 += ee*ee; }
+      for (let i = b * kBlock; i < (b + 1) * kBlock; i++) { const yy = cap[i]; const ee = out[i]; y2 += yy*yy; e2 += ee*ee; }
       const ratio = y2 > 0 ? (e2 / y2) : 0;
-      const dblk = mod._aec3_get_estimated_delay_blocks(h);
-      const dms = dblk >= 0 ? (dblk * (1000.0 * kBlock / kSr)) : -1;
-      console.log(`block=${blockCounter} y2=${y2.toExponential()} e2=${e2.toExponential()} e2_over_y2=${ratio.toExponential()} est_delay_blocks=${dblk} est_delay_ms=${dms.toFixed(3)}`);
-      blockCounter += 1;
-      refBlocksProcessed += 1;
-      processedAny = true;
+      console.log(`block=${refBlocksProcessed + b} y2=${y2.toExponential()} e2=${e2.toExponential()} e2_over_y2=${ratio.toExponential()} est_delay_blocks=${dblk} est_delay_ms=${dms.toFixed(3)}`);
     }
-    return processedAny;
+    refBlocksProcessed += n;
+    return true;
+  }
+
+  // Write processed.wav straight from the heap, then release the heap buffers and the canceller.
+  function writeProcessed() {
+    const n = refBlocksProcessed * kBlock;
+    writeWavPcm16Mono16k('processed.wav', mod.HEAP16.subarray(outBase, outBase + n));
+    mod._free(pFar); mod._free(pCap); mod._free(pOut);
+    mod._aec3_destroy(h);
+    return n;
   }
 
   function finishIfDone() {
     if (!donePlaying) return;
-    if (refBlocksProcessed < totalBlocks) return;
-    if (recQ.length >= kBlock && postPlaybackTicks < maxPostPlaybackTicks) return;
+    // everything processed, or the mic stopped delivering
+    if (refBlocksProcessed < totalBlocks && postPlaybackTicks < maxPostPlaybackTicks) return;
     if (finished) return;
     finished = true;
     clearInterval(timer);
     shutdown();
-    const totalSamples = refBlocksProcessed * kBlock;
-    const outSamples = new Int16Array(totalSamples);
-    for (let i = 0; i < totalSamples; i++) outSamples[i] = processed[i] || 0;
-    writeWavPcm16Mono16k('processed.wav', outSamples);
-    console.error(`processed.wav written (${totalSamples} samples).`);
+    const n = writeProcessed();
+    console.error(`processed.wav written (${n} samples).`);
     process.exit(0);
   }
 
   const tickMs = Math.floor(1000 * kBlock / kSr);
   const timer = setInterval(() => {
     if (!donePlaying && blocksSent < totalBlocks) {
-      const block = new Int16Array(kBlock);
-      const remain = far.length - playIdx;
-      const copyCount = remain >= kBlock ? kBlock : remain;
-      if (copyCount > 0) {
-        const slice = far.subarray(playIdx, playIdx + copyCount);
-        block.set(slice);
-      }
-      if (copyCount < kBlock) {
-        for (let i = copyCount; i < kBlock; i++) block[i] = 0;
+      const src = farBase + blocksSent * kBlock;
+      if (playViews) {
+        PortAudio.pushSamplesForPlay(mod.HEAP16.subarray(src, src + kBlock));
+      } else {
+        playBlock.set(mod.HEAP16.subarray(src, src + kBlock));
+        PortAudio.pushSamplesForPlay(playBlock);
       }
-      playIdx += copyCount;
       blocksSent += 1;
-      pushArray(refQ, block);
-      PortAudio.pushSamplesForPlay(block);
       if (blocksSent >= totalBlocks) donePlaying = true;
     } else {
       postPlaybackTicks += 1;
     }
 
-    const recBuf = PortAudio.getRecordedSamples();
-    const recArr = toInt16Array(recBuf);
-    if (recArr.length > 0) {
-      pushArray(recQ, recArr);
-      if (typeof PortAudio.discardRecordedSamples === 'function') PortAudio.discardRecordedSamples(recArr.length);
-      postPlaybackTicks = 0;
+    if (capSamples < totalSamples) {
+      const n = readMic(PortAudio, mod, capBase + capSamples, totalSamples - capSamples);
+      capSamples += n;
+      if (n > 0) postPlaybackTicks = 0;
     }
 
     processAvailableBlocks();
@@ -221,10 +231,7 @@ function toInt16Array(x) {
     finished = true;
     clearInterval(timer);
     shutdown();
-    const totalSamples = refBlocksProcessed * kBlock;
-    const outSamples = new Int16Array(totalSamples);
-    for (let i = 0; i < totalSamples; i++) outSamples[i] = processed[i] || 0;
-    writeWavPcm16Mono16k('processed.wav', outSamples);
+    writeProcessed();
     console.error('stopped. processed.wav written.');
     process.exit(0);
   });
@@ -20,27 +20,39 @@ inline void DecimateBy4(std::span<const float> in, std::span<float> out) {
 // レンダーブロックを遅延付きで保持し、指定遅延で取り出せるようにする。
 struct RenderDelayBuffer {
   inline static constexpr size_t kDownSamplingFactor = 4; // 遅延推定で用いるダウンサンプリング倍率
+  // これ以下のブロックパワーのレンダーは無音として扱う（振幅100相当）
+  inline static constexpr float kActiveRenderEnergyThreshold = kBlockSize * 100.f * 100.f;
+  const DelaySearchConfig config_; // 遅延探索範囲（Sanitized() 済み）
   const int sub_block_size_; // ダウンサンプル後のサブブロック長
   BlockBuffer blocks_; // レンダーブロックのリングバッファ
   SpectrumBuffer spectra_; // レンダースペクトルのリングバッファ
   FftBuffer ffts_; // FFT済みレンダーデータのリングバッファ
+  std::vector<uint8_t> render_activity_; // ブロックごとのレンダー有音フラグ（spectra_ と同じ添字）
   int delay_; // 現在適用中の遅延（ブロック単位）
   RenderBuffer echo_remover_buffer_; // EchoRemoverへ渡すバッファビュー
   DownsampledRenderBuffer low_rate_; // ダウンサンプリング済みレンダーデータ
   std::vector<float> render_ds_; // ダウンサンプル用ワーク領域
   const int buffer_headroom_; // バッファの安全余裕ブロック数
     
-  RenderDelayBuffer()
-      : sub_block_size_(static_cast<int>(kBlockSize / kDownSamplingFactor)),
+  // バッファ長は遅延探索範囲 config に合わせる（EchoPathDelayEstimator と同じ値を渡すこと）。
+  explicit RenderDelayBuffer(const DelaySearchConfig& config = {})
+      : config_(config.Sanitized()),
+        sub_block_size_(static_cast<int>(kBlockSize / kDownSamplingFactor)),
         blocks_(GetRenderDelayBufferSize(kDownSamplingFactor,
-                                         /*num_filters=*/5,
-                                         /*filter_length_blocks=*/13)),
-        spectra_(blocks_.buffer.size()),
-        ffts_(blocks_.buffer.size()),
+                                         config_.num_filters,
+                                         /*filter_length_blocks=*/13,
+                                         config_.window_size_sub_blocks)),
+        spectra_(blocks_.buffer.size(), /*sum_length=*/13),
+        ffts_(blocks_.buffer.size(),
+              /*mirror_size=*/13 + 1),
+        render_activity_(blocks_.buffer.size(), 0),
         delay_(-1),
-        echo_remover_buffer_(&blocks_, &spectra_, &ffts_),
+        echo_remover_buffer_(&blocks_, &spectra_, &ffts_, &render_activity_),
         low_rate_(GetDownSampledBufferSize(kDownSamplingFactor,
-                                           /*num_filters=*/5)),
+                                           config_.num_filters,
+                                           config_.window_size_sub_blocks),
+                  /*mirror_size=*/config_.window_size_sub_blocks *
+                      (kBlockSize / kDownSamplingFactor)),
         render_ds_(sub_block_size_, 0.f),
         buffer_headroom_(13) {
     Reset();
@@ -76,8 +88,8 @@ struct RenderDelayBuffer {
     delay_ = static_cast<int>(delay);
     // ダウンサンプル済みバッファの現在レイテンシ(ブロック数)を算出し、外部推定遅延に加算する。
     const int latency_samples =
-        (low_rate_.buffer.size() + low_rate_.read - low_rate_.write) %
-        low_rate_.buffer.size();
+        (low_rate_.size + low_rate_.read - low_rate_.write) %
+        low_rate_.size;
     const int latency_blocks = latency_samples / sub_block_size_;
     int total_delay = latency_blocks + delay_;
     total_delay = static_cast<int>(std::min(MaxDelay(), static_cast<size_t>(std::max(total_delay, 0))));
@@ -98,6 +110,7 @@ struct RenderDelayBuffer {
     blocks_.read = blocks_.OffsetIndex(blocks_.write, -delay);
     spectra_.read = spectra_.OffsetIndex(spectra_.write, delay);
     ffts_.read = ffts_.OffsetIndex(ffts_.write, delay);
+    spectra_.RebuildSum();
   }
   // ブロックを挿入して各種バッファを更新する。
   // block: 追加するレンダーブロック, previous_write: 更新前のwrite位置
@@ -110,10 +123,21 @@ struct RenderDelayBuffer {
     std::copy(block.begin(), block.end(), b.buffer[b.write].begin());
     DecimateBy4(b.buffer[b.write], ds);
     std::copy(ds.rbegin(), ds.rend(), lr.buffer.begin() + lr.write);
+    lr.UpdateMirror(lr.write, static_cast<int>(ds.size()));
     PaddedFft(b.buffer[b.write],
               b.buffer[previous_write],
               &f.buffer[f.write]);
+    f.UpdateMirror(f.write);
     f.buffer[f.write].Spectrum(s.buffer[s.write]);
+    if (s.InSumWindow(s.write)) {
+      // 書き込みが読み出しに追いついて窓内を上書きした場合のみ（通常は起きない）。
+      s.RebuildSum();
+    }
+    float x2 = 0.f;
+    for (const float x : block) {
+      x2 += x * x;
+    }
+    render_activity_[s.write] = x2 > kActiveRenderEnergyThreshold;
   }
   void IncrementWriteIndices() {
     low_rate_.UpdateWriteIndex(-sub_block_size_);
@@ -133,19 +157,126 @@ struct RenderDelayBuffer {
 
  
 
+// マッチドフィルタの内積 Σ h[k]·x[k]（スカラー版、参照実装）。
+inline float MatchedFilterDot_C(const float* h, const float* x, size_t n) {
+  float s = 0.f;
+  for (size_t k = 0; k < n; ++k) {
+    s += h[k] * x[k];
+  }
+  return s;
+}
+
+// マッチドフィルタのNLMS更新 h += alpha·x（スカラー版、参照実装）。
+inline void MatchedFilterAdapt_C(float alpha, const float* x, size_t n, float* h) {
+  for (size_t k = 0; k < n; ++k) {
+    h[k] += alpha * x[k];
+  }
+}
+
+#if defined(__ARM_NEON)
+// NEON版。n は8の倍数であること（内積は2本のアキュムレータで8要素ずつ進む）。
+inline float MatchedFilterDot_NEON(const float* h, const float* x, size_t n) {
+  float32x4_t s0 = vdupq_n_f32(0.f);
+  float32x4_t s1 = vdupq_n_f32(0.f);
+  for (size_t k = 0; k < n; k += 8) {
+    s0 = vfmaq_f32(s0, vld1q_f32(h + k), vld1q_f32(x + k));
+    s1 = vfmaq_f32(s1, vld1q_f32(h + k + 4), vld1q_f32(x + k + 4));
+  }
+  return vaddvq_f32(vaddq_f32(s0, s1));
+}
+
+inline void MatchedFilterAdapt_NEON(float alpha, const float* x, size_t n, float* h) {
+  const float32x4_t a = vdupq_n_f32(alpha);
+  for (size_t k = 0; k < n; k += 4) {
+    vst1q_f32(h + k, vfmaq_f32(vld1q_f32(h + k), a, vld1q_f32(x + k)));
+  }
+}
+#elif defined(__wasm_simd128__)
+// WASM SIMD版（-msimd128）。n は8の倍数であること。FMAはないので乗算と加算で行う。
+inline float MatchedFilterDot_WASM(const float* h, const float* x, size_t n) {
+  v128_t s0 = wasm_f32x4_splat(0.f);
+  v128_t s1 = wasm_f32x4_splat(0.f);
+  for (size_t k = 0; k < n; k += 8) {
+    s0 = wasm_f32x4_add(s0, wasm_f32x4_mul(wasm_v128_load(h + k), wasm_v128_load(x + k)));
+    s1 = wasm_f32x4_add(s1, wasm_f32x4_mul(wasm_v128_load(h + k + 4), wasm_v128_load(x + k + 4)));
+  }
+  const v128_t s = wasm_f32x4_add(s0, s1);
+  return (wasm_f32x4_extract_lane(s, 0) + wasm_f32x4_extract_lane(s, 1)) +
+         (wasm_f32x4_extract_lane(s, 2) + wasm_f32x4_extract_lane(s, 3));
+}
+
+inline void MatchedFilterAdapt_WASM(float alpha, const float* x, size_t n, float* h) {
+  const v128_t a = wasm_f32x4_splat(alpha);
+  for (size_t k = 0; k < n; k += 4) {
+    wasm_v128_store(h + k, wasm_f32x4_add(wasm_v128_load(h + k), wasm_f32x4_mul(a, wasm_v128_load(x + k))));
+  }
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+// AVX2/FMA版。n は16の倍数であること。x はミラー領域上の任意位置なので非整列ロードを使う。
+inline float MatchedFilterDot_AVX2(const float* h, const float* x, size_t n) {
+  __m256 s0 = _mm256_setzero_ps();
+  __m256 s1 = _mm256_setzero_ps();
+  for (size_t k = 0; k < n; k += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(h + k), _mm256_loadu_ps(x + k), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(h + k + 8), _mm256_loadu_ps(x + k + 8), s1);
+  }
+  const __m256 s = _mm256_add_ps(s0, s1);
+  __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+  s4 = _mm_add_ps(s4, _mm_movehl_ps(s4, s4));
+  s4 = _mm_add_ss(s4, _mm_shuffle_ps(s4, s4, 1));
+  return _mm_cvtss_f32(s4);
+}
+
+inline void MatchedFilterAdapt_AVX2(float alpha, const float* x, size_t n, float* h) {
+  const __m256 a = _mm256_set1_ps(alpha);
+  for (size_t k = 0; k < n; k += 8) {
+    _mm256_storeu_ps(h + k, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + k), _mm256_loadu_ps(h + k)));
+  }
+}
+#endif
+
+// 実装はコンパイル時に選ぶ（subtractor.h のパーティションカーネルと同じ条件）。
+inline float MatchedFilterDot(const float* h, const float* x, size_t n) {
+#if defined(__ARM_NEON)
+  return MatchedFilterDot_NEON(h, x, n);
+#elif defined(__wasm_simd128__)
+  return MatchedFilterDot_WASM(h, x, n);
+#elif defined(__AVX2__) && defined(__FMA__)
+  return MatchedFilterDot_AVX2(h, x, n);
+#else
+  return MatchedFilterDot_C(h, x, n);
+#endif
+}
+
+inline void MatchedFilterAdapt(float alpha, const float* x, size_t n, float* h) {
+#if defined(__ARM_NEON)
+  MatchedFilterAdapt_NEON(alpha, x, n, h);
+#elif defined(__wasm_simd128__)
+  MatchedFilterAdapt_WASM(alpha, x, n, h);
+#elif defined(__AVX2__) && defined(__FMA__)
+  MatchedFilterAdapt_AVX2(alpha, x, n, h);
+#else
+  MatchedFilterAdapt_C(alpha, x, n, h);
+#endif
+}
+
 // 複数の信号シフトに対する相互相関を逐次更新し、遅延候補を推定する。
 struct MatchedFilter {
-  static constexpr size_t kNumFilters = 5; // 追跡する遅延候補数
   static constexpr size_t kSubBlockSize = kBlockSize / 4; // ダウンサンプル後サブブロック長
-  static constexpr size_t kFilterLength = kMatchedFilterWindowSizeSubBlocks * kSubBlockSize; // 各フィルタ長
-  static constexpr size_t kFilterIntraLagShift = kMatchedFilterAlignmentShiftSizeSubBlocks * kSubBlockSize; // フィルタ間の遅延シフト量
-  static constexpr size_t kMaxFilterLag = kNumFilters * kFilterIntraLagShift + kFilterLength; // 推定する最大遅延
+  const size_t filter_length_; // 各フィルタ長（窓幅 * kSubBlockSize）
+  const size_t filter_intra_lag_shift_; // フィルタ間の遅延シフト量
+  const size_t max_filter_lag_; // 推定する最大遅延
 
   std::vector<std::vector<float>> filters_; // 遅延候補ごとの適応フィルタ係数
   int reported_lag_ = -1; // 現在報告している遅延
   int winner_lag_ = -1; // 直近日に最も信頼できた遅延
     
-  MatchedFilter() : filters_( /*num_filters=*/kNumFilters, std::vector<float>(kFilterLength, 0.f)) {}
+  // config は Sanitized() 済みであること。
+  explicit MatchedFilter(const DelaySearchConfig& config)
+      : filter_length_(config.window_size_sub_blocks * kSubBlockSize),
+        filter_intra_lag_shift_(config.AlignmentShiftSubBlocks() * kSubBlockSize),
+        max_filter_lag_(config.num_filters * filter_intra_lag_shift_ + filter_length_),
+        filters_(config.num_filters, std::vector<float>(filter_length_, 0.f)) {}
   
   static size_t MaxSquarePeakIndex(std::span<const float> coefficients) {
     if (coefficients.size() < 2) {
@@ -179,22 +310,23 @@ struct MatchedFilter {
     return lag_estimate1;
   }
 
+  // x: ミラー領域付きのダウンサンプル済みレンダーバッファ, x_size: ミラー領域を除いたリング長。
+  // ミラー領域がフィルタ長以上あるので、x[x_start_index] から h.size() 個を折り返しなしで読める。
+  // 窓のパワー x2_sum はサンプルごとに1つ進むだけなので、入ってくるサンプルと出ていくサンプルの
+  // 差分で更新する。誤差の蓄積を防ぐため、呼び出しの先頭（16サンプルごと）で全長から計算し直す。
   void MatchedFilterCore(size_t x_start_index,
                          float x2_sum_threshold,
                          std::span<const float> x,
+                         size_t x_size,
                          std::span<const float> y,
                          std::span<float> h,
                          bool* filters_updated,
                          float* error_sum) const {
+    const size_t n = h.size();
+    float x2_sum = MatchedFilterDot(&x[x_start_index], &x[x_start_index], n);
     for (size_t i = 0; i < y.size(); ++i) {
-      float x2_sum = 0.f;
-      float s = 0.f;
-      size_t x_index = x_start_index;
-      for (size_t k = 0; k < h.size(); ++k) {
-        x2_sum += x[x_index] * x[x_index];
-        s += h[k] * x[x_index];
-        x_index = x_index < (x.size() - 1) ? x_index + 1 : 0;
-      }
+      const float* x_i = &x[x_start_index];
+      const float s = MatchedFilterDot(h.data(), x_i, n);
 
       const float e = y[i] - s;
       (*error_sum) += e * e;
@@ -202,22 +334,26 @@ struct MatchedFilter {
       if (x2_sum > x2_sum_threshold) {
         // 平滑係数0.7fでNLMS更新
         const float alpha = 0.7f * e / x2_sum;
-        size_t adapt_index = x_start_index;
-        for (size_t k = 0; k < h.size(); ++k) {
-          h[k] += alpha * x[adapt_index];
-          adapt_index = adapt_index < (x.size() - 1) ? adapt_index + 1 : 0;
-        }
+        MatchedFilterAdapt(alpha, x_i, n, h.data());
         *filters_updated = true;
       }
 
-      x_start_index = x_start_index > 0 ? x_start_index - 1 : x.size() - 1;
+      // 窓を1サンプル新しい側へずらす。x[x_start_index + n] は抜ける最古サンプル（ミラー領域内）。
+      x_start_index = x_start_index > 0 ? x_start_index - 1 : x_size - 1;
+      const float x_in = x[x_start_index];
+      const float x_out = x[x_start_index + n];
+      x2_sum = std::max(0.f, x2_sum + x_in * x_in - x_out * x_out);
     }
   }
 
 
   // キャプチャバッファを使って相互相関を更新する。
+  // [first_filter, last_filter) のフィルタだけを更新・評価する（既定は全フィルタ）。
+  // 範囲外のフィルタの係数はそのまま残る。
   void Update(const DownsampledRenderBuffer& render_buffer,
-              std::span<const float> capture) {
+              std::span<const float> capture,
+              size_t first_filter = 0,
+              size_t last_filter = SIZE_MAX) {
 
     // 励起不足で更新を止める閾値(入力パワー下限150.f)
     const float x2_sum_threshold =
@@ -231,20 +367,20 @@ struct MatchedFilter {
     float winner_error_sum = error_sum_anchor;
     winner_lag_ = -1;
     reported_lag_ = -1;
-    size_t alignment_shift = 0;
+    size_t alignment_shift = first_filter * filter_intra_lag_shift_;
     int previous_lag_estimate = -1;
-    const int num_filters = static_cast<int>(filters_.size());
+    const int num_filters = static_cast<int>(std::min(last_filter, filters_.size()));
 
     int winner_index = -1;
-    for (int n = 0; n < num_filters; ++n) {
+    for (int n = static_cast<int>(first_filter); n < num_filters; ++n) {
       float error_sum = 0.f;
       bool filters_updated = false;
       size_t x_start_index =
           (render_buffer.read + alignment_shift + kSubBlockSize - 1) %
-          render_buffer.buffer.size();
+          render_buffer.size;
 
       MatchedFilterCore(x_start_index, x2_sum_threshold,
-                        render_buffer.buffer, capture, filters_[n],
+                        render_buffer.buffer, render_buffer.size, capture, filters_[n],
                         &filters_updated, &error_sum);
 
       const size_t lag_estimate = MaxSquarePeakIndex(filters_[n]);
@@ -266,7 +402,7 @@ struct MatchedFilter {
       }
 
       previous_lag_estimate = lag;
-      alignment_shift += kFilterIntraLagShift;
+      alignment_shift += filter_intra_lag_shift_;
     }
 
     if (winner_index != -1) {
@@ -286,41 +422,239 @@ struct MatchedFilter {
   // 現在の遅延推定値を返す。
   int GetBestLagEstimate() const { return reported_lag_; }
 
+  // 遅延 lag（ダウンサンプル後のサンプル数）を信頼できる推定として出せるフィルタの範囲
+  // [*first_filter, *last_filter) を求める。Update の reliable 判定と同じ余裕（先頭3、末尾10）を使う。
+  void FiltersCoveringLag(int lag, size_t* first_filter, size_t* last_filter) const {
+    *first_filter = filters_.size();
+    *last_filter = 0;
+    for (size_t n = 0; n < filters_.size(); ++n) {
+      const int begin = static_cast<int>(n * filter_intra_lag_shift_) + 3;
+      const int end = static_cast<int>(n * filter_intra_lag_shift_ + filter_length_) - 10;
+      if (lag >= begin && lag < end) {
+        *first_filter = std::min(*first_filter, n);
+        *last_filter = n + 1;
+      }
+    }
+  }
 
+};
+// 周波数領域の相互相関で遅延を推定する、MatchedFilter の代替エンジン。
+// ダウンサンプル後の64サンプルを1フレームとし、レンダー履歴を64サンプル刻みの
+// パーティションに分けてオーバーラップセーブ法で相互相関を求める。
+// パーティション j は遅延 [64j, 64j+64) を受け持ち、128サンプル窓のレンダーFFTと
+// 後半ゼロ詰めのキャプチャFFTの相互スペクトルを時間平滑化して保持する。
+// 相関はSCOT重み 1/sqrt(Sxx·Syy) で白色化してから逆FFTし、全パーティションの最大ピークを採る。
+// ピークは相関値のRMSに対してだけでなく、ピーク近傍を除いた最大のサイドローブに対しても
+// 十分大きいときだけ報告する（周期的な信号や無相関区間で偽の遅延を出さないため）。
+// フレームごとに新たに必要なFFTはレンダー1回とキャプチャ1回だけで、
+// 古いパーティションのレンダーFFTは1フレームずつずらして再利用する。
+// 報告する遅延の単位と基準位置は MatchedFilter と同じ（ダウンサンプル後のサンプル数）。
+struct FftMatchedFilter {
+  static constexpr size_t kSubBlockSize = kBlockSize / 4; // ダウンサンプル後サブブロック長
+  static constexpr size_t kFrameSize = kFftLengthBy2; // 1フレーム（=1パーティション）のサンプル数
+  static constexpr float kSmoothing = 0.9f; // 相互スペクトルの平滑化係数（1フレーム=16ms）
+  static constexpr float kPeakToRmsThreshold = 8.f; // ピークが相関値のRMSの何倍なら信頼するか
+  static constexpr float kPeakToSidelobeThreshold = 1.5f; // ピークが最大サイドローブの何倍なら信頼するか
+  static constexpr int kMainlobeHalfWidth = 8; // サイドローブ探索から除くピーク前後の遅延幅（ダウンサンプル後のサンプル数）
+
+  const size_t num_partitions_; // パーティション数（最大遅延 = num_partitions_ * kFrameSize）
+  std::vector<FftData> X_; // パーティションごとのレンダーFFT（リング、x_newest_ がパーティション0）
+  size_t x_newest_ = 0; // パーティション0のリング位置
+  std::vector<FftData> Sxy_; // パーティションごとの平滑化相互スペクトル X·conj(Y)
+  std::array<float, kFftLengthBy2Plus1> Sxx_; // レンダーの平滑化パワースペクトル
+  std::array<float, kFftLengthBy2Plus1> Syy_; // キャプチャの平滑化パワースペクトル
+  std::array<float, kFrameSize> y_frame_; // 蓄積中のキャプチャフレーム
+  std::vector<float> c2_; // 遅延ごとの白色化相関の2乗（直近フレーム）
+  size_t y_frame_fill_ = 0; // y_frame_ に蓄積済みのサンプル数
+  int reported_lag_ = -1; // 直近フレームで報告した遅延
+
+  FftMatchedFilter(size_t num_partitions)
+      : num_partitions_(num_partitions),
+        X_(num_partitions),
+        Sxy_(num_partitions),
+        c2_(num_partitions * kFrameSize) {
+    Reset();
+  }
 
+  // キャプチャのサブブロックを蓄積し、1フレーム揃うごとに相互相関を更新する。
+  // 遅延推定値を更新したフレームで true を返す（フレームの途中では false）。
+  // render_buffer の読み出し位置から128サンプルを連続で読むため、ミラー領域が必要。
+  bool Update(const DownsampledRenderBuffer& render_buffer,
+              std::span<const float> capture) {
+    std::copy(capture.begin(), capture.end(), y_frame_.begin() + y_frame_fill_);
+    y_frame_fill_ += capture.size();
+    if (y_frame_fill_ < kFrameSize) {
+      return false;
+    }
+    y_frame_fill_ = 0;
+
+    // キャプチャサンプル m に対応するレンダーは read + 63 - m にある（バッファは時間逆順）。
+    // パーティション0の窓は時刻 [-64, 64) なので、read から128サンプルを逆順に並べる。
+    std::array<float, kFftLength> fft;
+    const float* x = &render_buffer.buffer[render_buffer.read];
+    float x2_sum = 0.f;
+    for (size_t i = 0; i < kFftLength; ++i) {
+      fft[i] = x[kFftLength - 1 - i];
+      x2_sum += fft[i] * fft[i];
+    }
+    x_newest_ = x_newest_ > 0 ? x_newest_ - 1 : num_partitions_ - 1;
+    Fft(&fft, &X_[x_newest_]);
+
+    // 励起不足で更新を止める閾値(入力パワー下限150.f)は MatchedFilter と同じ。
+    if (x2_sum <= kFftLength * 150.f * 150.f) {
+      reported_lag_ = -1;
+      return true;
+    }
+
+    // キャプチャフレームにはハン窓を掛ける。矩形のままだと白色化でフレーム端が強調され、
+    // 窓端が揃う遅延 64j に偽のピークが立つ。
+    FftData Y;
+    for (size_t m = 0; m < kFrameSize; ++m) {
+      const float w = kSqrtHanning128[2 * m];
+      fft[m] = y_frame_[m] * w * w;
+    }
+    std::fill(fft.begin() + kFrameSize, fft.end(), 0.f);
+    Fft(&fft, &Y);
+
+    const FftData& X0 = X_[x_newest_];
+    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+      Sxx_[k] = kSmoothing * Sxx_[k] +
+                (1.f - kSmoothing) * (X0.re[k] * X0.re[k] + X0.im[k] * X0.im[k]);
+      Syy_[k] = kSmoothing * Syy_[k] +
+                (1.f - kSmoothing) * (Y.re[k] * Y.re[k] + Y.im[k] * Y.im[k]);
+    }
+    std::array<float, kFftLengthBy2Plus1> weight;
+    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+      weight[k] = 1.f / std::sqrt(Sxx_[k] * Syy_[k] + 1e-6f);
+    }
+
+    float peak = 0.f;
+    float c2_sum = 0.f;
+    int peak_lag = -1;
+    size_t index = x_newest_;
+    for (size_t j = 0; j < num_partitions_; ++j) {
+      const FftData& X = X_[index];
+      FftData& S = Sxy_[j];
+      FftData R;
+      for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+        S.re[k] = kSmoothing * S.re[k] +
+                  (1.f - kSmoothing) * (X.re[k] * Y.re[k] + X.im[k] * Y.im[k]);
+        S.im[k] = kSmoothing * S.im[k] +
+                  (1.f - kSmoothing) * (X.im[k] * Y.re[k] - X.re[k] * Y.im[k]);
+        R.re[k] = S.re[k] * weight[k];
+        R.im[k] = S.im[k] * weight[k];
+      }
+      // c[n] = Σ_m y[m]·x_j[m + n] の n = 1..64 が遅延 64j + 64 - n に対応する。
+      Ifft(R, &fft);
+      for (size_t n = 1; n <= kFrameSize; ++n) {
+        const float c2 = fft[n] * fft[n];
+        c2_[j * kFrameSize + kFrameSize - n] = c2;
+        c2_sum += c2;
+        if (c2 > peak) {
+          peak = c2;
+          peak_lag = static_cast<int>(j * kFrameSize + kFrameSize - n);
+        }
+      }
+      index = index < num_partitions_ - 1 ? index + 1 : 0;
+    }
+
+    const float c2_mean = c2_sum / static_cast<float>(num_partitions_ * kFrameSize);
+    float sidelobe = 0.f;
+    for (int lag = 0; lag < static_cast<int>(c2_.size()); ++lag) {
+      if (std::abs(lag - peak_lag) > kMainlobeHalfWidth) {
+        sidelobe = std::max(sidelobe, c2_[lag]);
+      }
+    }
+    const bool reliable =
+        peak > kPeakToRmsThreshold * kPeakToRmsThreshold * c2_mean &&
+        peak > kPeakToSidelobeThreshold * kPeakToSidelobeThreshold * sidelobe;
+    reported_lag_ = reliable ? peak_lag : -1;
+    return true;
+  }
+
+  // 状態をリセットする。
+  void Reset() {
+    for (FftData& X : X_) X.Clear();
+    y_frame_fill_ = 0;
+    ResetStatistics();
+  }
+
+  // 相関とパワーの統計だけをリセットする。レンダーFFTの履歴とフレーム位置は残すので、
+  // 長い遅延のパーティションも次のフレームからすぐ相関を取り直せる。
+  void ResetStatistics() {
+    for (FftData& S : Sxy_) S.Clear();
+    Sxx_.fill(0.f);
+    Syy_.fill(0.f);
+    reported_lag_ = -1;
+  }
+
+  // 現在の遅延推定値を返す。
+  int GetBestLagEstimate() const { return reported_lag_; }
 };
+
 // 直近期の遅延推定値をヒストグラムで管理し、最も多く出現した遅延を候補とする集約器。
+// 最大値の位置は葉がヒストグラムのビンに対応する完全二分木で保持する。各内部ノードは子の
+// うち出現回数が多い方（同数なら左=小さい遅延）のビン番号を持つので、根が std::max_element と
+// 同じ候補になる。1ブロックで変わるのは2ビンだけなので、更新は探索範囲によらず O(log ビン数) で済む。
 struct HighestPeakAggregator {
-    std::vector<int> histogram_; // 遅延ごとの出現回数を保持するヒストグラム
+    const int num_bins_; // ヒストグラムのビン数（max_filter_lag + 1）
+    const int num_leaves_; // 木の葉の数（num_bins_ 以上の2のべき乗）
+    std::vector<int> histogram_; // 遅延ごとの出現回数を保持するヒストグラム（num_leaves_ 要素、末尾は未使用）
+    std::vector<int> tree_; // 最大値を追跡する二分木（tree_[1] が根、葉 num_leaves_ + i がビン i）
     std::array<int, 250> histogram_data_; // 最近の遅延推定値をFIFOで保持するバッファ
     int histogram_data_index_ = 0; 
     int candidate_ = -1; // 現在最も出現頻度が高い遅延候補
 
     HighestPeakAggregator(size_t max_filter_lag)
-        : histogram_(max_filter_lag + 1, 0) {
-        histogram_data_.fill(0);
+        : num_bins_(static_cast<int>(max_filter_lag + 1)),
+          num_leaves_(static_cast<int>(std::bit_ceil(max_filter_lag + 1))),
+          histogram_(num_leaves_, 0),
+          tree_(2 * num_leaves_, 0) {
+        Reset();
     }
     // 状態をリセットする。
     void Reset() {
         std::fill(histogram_.begin(), histogram_.end(), 0);
+        for (int i = 0; i < num_leaves_; ++i) {
+            tree_[num_leaves_ + i] = i;
+        }
+        for (int k = num_leaves_ - 1; k >= 1; --k) {
+            tree_[k] = Better(tree_[2 * k], tree_[2 * k + 1]);
+        }
         histogram_data_.fill(0);
         histogram_data_index_ = 0;
         candidate_ = -1;
     }
     // 遅延値をヒストグラムに追加し、候補を更新する。
     void Aggregate(int lag) {
-        --histogram_[histogram_data_[histogram_data_index_]];
+        const int oldest = histogram_data_[histogram_data_index_];
+        --histogram_[oldest];
         histogram_data_[histogram_data_index_] = lag;
-        ++histogram_[histogram_data_[histogram_data_index_]];
+        ++histogram_[lag];
         histogram_data_index_ = (histogram_data_index_ + 1) % histogram_data_.size();
-        candidate_ = std::distance(
-                                   histogram_.begin(),
-                                   std::max_element(histogram_.begin(), histogram_.end()));
+        if (oldest != lag) {
+            UpdateTree(oldest);
+            UpdateTree(lag);
+        }
+        candidate_ = tree_[1];
     }
     // 現在の候補遅延を返す。
     int candidate() const { return candidate_; }
     // ヒストグラム内容を参照する。
-    std::span<const int> histogram() const { return histogram_; }
+    std::span<const int> histogram() const {
+        return std::span<const int>(histogram_.data(), num_bins_);
+    }
+
+    // ビン a と b（a < b）のうち候補として優先する方を返す。木の右端にある未使用の葉は選ばない。
+    int Better(int a, int b) const {
+        return (b < num_bins_ && histogram_[b] > histogram_[a]) ? b : a;
+    }
+    // ビン bin の出現回数が変わったので、葉から根までのノードを更新する。
+    void UpdateTree(int bin) {
+        for (int k = (num_leaves_ + bin) / 2; k >= 1; k /= 2) {
+            tree_[k] = Better(tree_[2 * k], tree_[2 * k + 1]);
+        }
+    }
 };
 // マッチドフィルタが出す遅延推定を集約し、信頼できる値を選び出す。
 struct MatchedFilterLagAggregator {
@@ -362,21 +696,97 @@ struct MatchedFilterLagAggregator {
 // エコーパスの遅延を推定する。
 struct EchoPathDelayEstimator {
   inline static constexpr size_t kDownSamplingFactor = 4; // 遅延推定で用いるダウンサンプリング倍率
+  const DelaySearchConfig config_; // 遅延探索範囲（Sanitized() 済み）
   const size_t sub_block_size_; // ダウンサンプリング後のサブブロック長
   MatchedFilter matched_filter_; // 遅延候補を算出するマッチドフィルタ
+  FftMatchedFilter fft_matched_filter_; // 周波数領域で遅延候補を算出する代替エンジン
+  bool use_fft_matched_filter_ = false; // true なら fft_matched_filter_ を使う
+  int fft_aggregated_lag_ = -1; // FFT版で直近のフレームに集約器が返した遅延
   MatchedFilterLagAggregator matched_filter_lag_aggregator_; // マッチドフィルタの遅延推定値を平滑化する集約器
   int old_aggregated_lag_ = -1; // 直前に確定した遅延サンプル値
   size_t consistent_estimate_counter_ = 0; // 同一推定が続いた回数
+
+  // 低消費電力の追跡モード。集約器の遅延が kTrackingLockBlocks ブロック続いたら、
+  // その遅延を受け持つフィルタだけを毎ブロック更新し、全フィルタの探索は
+  // full_search_interval_blocks_ ブロックに1回に間引く。
+  // 集約器が別の遅延を出したとき、減算器の誤差が跳ねたとき、Reset() で全探索に戻る。
+  // FFT版エンジンはもともと軽いので対象外。
+  static constexpr size_t kTrackingLockBlocks = 50; // 追跡へ移るまでに同じ遅延が続くブロック数(200ms)
+  static constexpr float kErrorJumpRatio = 4.f; // e2/y2 が平滑値の何倍を超えたら誤差の跳ねと見なすか
+  static constexpr float kErrorJumpMinCaptureEnergy = kBlockSize * 100.f * 100.f; // 判定に使うキャプチャパワーの下限
+  static constexpr size_t kErrorJumpBlocks = 10; // 跳ねが何ブロック続いたら全探索へ戻すか(40ms)
+  bool low_power_tracking_ = false; // 追跡モードを許可するか
+  size_t full_search_interval_blocks_ = 25; // 追跡中に全探索を行う間隔（ブロック数）
+  bool tracking_ = false; // 追跡中か
+  int tracked_lag_ = -1; // 追跡中の遅延（EstimateDelay の戻り値と同じ単位）
+  size_t tracking_first_filter_ = 0; // 追跡中に更新するフィルタ範囲の先頭
+  size_t tracking_last_filter_ = 0; // 追跡中に更新するフィルタ範囲の末尾（含まない）
+  size_t blocks_since_full_search_ = 0; // 直近の全探索からのブロック数
+  float smoothed_error_ratio_ = 1.f; // 減算器の e2/y2 の平滑値
+  size_t error_jump_counter_ = 0; // e2/y2 が跳ねた状態の連続ブロック数
   
     
-  EchoPathDelayEstimator()
-      : sub_block_size_(kBlockSize / kDownSamplingFactor),
-        matched_filter_(),
-        matched_filter_lag_aggregator_(MatchedFilter::kMaxFilterLag) {}
+  // FFT版の探索範囲はダウンサンプル済みバッファ長から、128サンプル窓の先読み1パーティションと
+  // 読み書き位置の差の余裕1パーティションを除いた分とする。
+  // config は組み合わせる RenderDelayBuffer と同じ値にすること。
+  explicit EchoPathDelayEstimator(const DelaySearchConfig& config = {})
+      : config_(config.Sanitized()),
+        sub_block_size_(kBlockSize / kDownSamplingFactor),
+        matched_filter_(config_),
+        fft_matched_filter_(GetDownSampledBufferSize(kDownSamplingFactor,
+                                                     config_.num_filters,
+                                                     config_.window_size_sub_blocks) /
+                                FftMatchedFilter::kFrameSize -
+                            2),
+        matched_filter_lag_aggregator_(matched_filter_.max_filter_lag_) {}
+
+  // 遅延推定エンジンを切り替える。true なら時間領域NLMSの代わりに周波数領域の相互相関を使う。
+  void SetFftMatchedFilter(bool enable) {
+    use_fft_matched_filter_ = enable;
+    StopTracking();
+    ResetInternal();
+    fft_matched_filter_.Reset();
+  }
 
 
+  // 低消費電力の追跡モードを切り替える。full_search_interval_blocks は追跡中に全探索を行う間隔。
+  void SetLowPowerTracking(bool enable, size_t full_search_interval_blocks = 25) {
+    low_power_tracking_ = enable;
+    full_search_interval_blocks_ = std::max<size_t>(full_search_interval_blocks, 1);
+    StopTracking();
+  }
+
   // 推定状態を初期化する。遅延信頼度もリセットして再起動直後と同等に戻す。
-  void Reset() { ResetInternal(); }
+  void Reset() {
+    StopTracking();
+    ResetInternal();
+    fft_matched_filter_.Reset();
+  }
+
+  // 減算器の出力パワーを受け取り、追跡中に誤差が跳ねた状態が続いたら全探索へ戻す。
+  // 単発の跳ねは近端音声の立ち上がりでも起きるので、kErrorJumpBlocks ブロック続いたときだけ反応する。
+  // 跳ねている間は平滑値を更新しない。
+  // y2: キャプチャのブロックパワー, e2: 線形減算後の誤差のブロックパワー
+  void ObserveSubtractorError(float y2, float e2) {
+    if (y2 < kErrorJumpMinCaptureEnergy) {
+      return;
+    }
+    const float ratio = e2 / y2;
+    if (ratio > kErrorJumpRatio * smoothed_error_ratio_) {
+      if (++error_jump_counter_ >= kErrorJumpBlocks) {
+        error_jump_counter_ = 0;
+        smoothed_error_ratio_ = ratio;
+        if (tracking_) {
+          // エコーパスが変わったと見なし、古い遅延の投票とフィルタ係数を捨てて探索し直す。
+          StopTracking();
+          ResetInternal();
+        }
+      }
+      return;
+    }
+    error_jump_counter_ = 0;
+    smoothed_error_ratio_ += 0.1f * (ratio - smoothed_error_ratio_);
+  }
 
   // 遅延サンプル数を推定し、得られなければ -1 を返す。
   int EstimateDelay(
@@ -386,11 +796,26 @@ struct EchoPathDelayEstimator {
     std::span<float> downsampled_capture(downsampled_capture_data.data(),
                                          sub_block_size_);
     DecimateBy4(capture, downsampled_capture);
-    matched_filter_.Update(render_buffer, downsampled_capture);
-
-    int aggregated_matched_filter_lag =
-        matched_filter_lag_aggregator_.Aggregate(
-            matched_filter_.GetBestLagEstimate());
+    int aggregated_matched_filter_lag;
+    if (use_fft_matched_filter_) {
+      // FFT版は4ブロックで1フレームなので、推定値を更新したフレームだけ集約器に投票し、
+      // 間のブロックは直前の集約結果を保つ（同じ推定値を4票と数えない）。
+      if (fft_matched_filter_.Update(render_buffer, downsampled_capture)) {
+        fft_aggregated_lag_ = matched_filter_lag_aggregator_.Aggregate(
+            fft_matched_filter_.GetBestLagEstimate());
+      }
+      aggregated_matched_filter_lag = fft_aggregated_lag_;
+    } else {
+      if (tracking_ && ++blocks_since_full_search_ < full_search_interval_blocks_) {
+        matched_filter_.Update(render_buffer, downsampled_capture,
+                               tracking_first_filter_, tracking_last_filter_);
+      } else {
+        blocks_since_full_search_ = 0;
+        matched_filter_.Update(render_buffer, downsampled_capture);
+      }
+      aggregated_matched_filter_lag = matched_filter_lag_aggregator_.Aggregate(
+          matched_filter_.GetBestLagEstimate());
+    }
 
     if (aggregated_matched_filter_lag >= 0) {
       aggregated_matched_filter_lag *= static_cast<int>(kDownSamplingFactor);
@@ -403,16 +828,50 @@ struct EchoPathDelayEstimator {
       consistent_estimate_counter_ = 0;
     }
     old_aggregated_lag_ = aggregated_matched_filter_lag;
+    if (tracking_ && aggregated_matched_filter_lag >= 0 &&
+        aggregated_matched_filter_lag != tracked_lag_) {
+      // 集約値が動いたら追跡対象を移す。受け持つフィルタがなければ全探索に戻る。
+      StopTracking();
+      StartTracking(aggregated_matched_filter_lag);
+    } else if (!tracking_ && low_power_tracking_ && !use_fft_matched_filter_ &&
+               consistent_estimate_counter_ >= kTrackingLockBlocks) {
+      StartTracking(aggregated_matched_filter_lag);
+    }
     const size_t kNumBlocksPerSecondBy2 = kNumBlocksPerSecond / 2;
     if (consistent_estimate_counter_ > kNumBlocksPerSecondBy2) {
       ResetInternal();
     }
     return aggregated_matched_filter_lag;
   }
+  // lag を受け持つフィルタを求めて追跡を始める。該当するフィルタがなければ何もしない。
+  void StartTracking(int lag) {
+    const int downsampled_lag =
+        lag / static_cast<int>(kDownSamplingFactor) +
+        matched_filter_lag_aggregator_.headroom_;
+    matched_filter_.FiltersCoveringLag(downsampled_lag, &tracking_first_filter_,
+                                       &tracking_last_filter_);
+    if (tracking_first_filter_ >= tracking_last_filter_) {
+      return;
+    }
+    tracking_ = true;
+    tracked_lag_ = lag;
+    blocks_since_full_search_ = 0;
+  }
+
+  // 追跡を終えて毎ブロック全探索に戻る。
+  void StopTracking() {
+    tracking_ = false;
+    tracked_lag_ = -1;
+  }
+
   // 内部状態をまとめてリセットする補助関数。
+  // 追跡状態は残す（一定時間ごとのリセット後も、追跡中のフィルタだけで再収束させる）。
+  // FFT版のレンダー履歴も残す（切り替え時と Reset() では別途消す）。
   void ResetInternal() {
     matched_filter_lag_aggregator_.Reset();
     matched_filter_.Reset();
+    fft_matched_filter_.ResetStatistics();
+    fft_aggregated_lag_ = -1;
     old_aggregated_lag_ = -1;
     consistent_estimate_counter_ = 0;
   }
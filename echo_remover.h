@@ -9,12 +9,14 @@ struct EchoRemover {
   std::array<float, kFftLengthBy2> y_old_{}; // 入力信号の前ブロックを保持
   bool enable_linear_filter_ = true; // 線形減算を有効にするか
   bool enable_nonlinear_suppressor_ = true; // 非線形抑圧を有効にするか
+  bool enable_render_gating_ = true; // レンダー無音時に線形フィルタと抑圧を省略するか
   struct LastMetrics {
       float e2=0.f;
       float y2=0.f;
       float erle_avg=0.f;
       bool linear_usable=false;
       float output_e2=0.f;
+      bool render_active=false; // 線形フィルタの範囲に有音のレンダーがあったか
       bool valid=false;
   } last_metrics_;
 
@@ -33,9 +35,23 @@ struct EchoRemover {
     enable_nonlinear_suppressor_ = enable_nonlinear_suppressor;
   }
 
+  // レンダー無音時の省略（ゲーティング）を設定する。
+  void SetRenderGating(bool enable) { enable_render_gating_ = enable; }
+
   // キャプチャ信号1ブロックからエコー成分を除去する。
   // delay_changed: 直前のブロックで遅延アラインメントが更新されたか,
   // render_buffer: レンダーバッファ, capture: キャプチャブロック
+  //
+  // 1ブロックあたりの128点変換の回数（レンダー側の PaddedFft 1回は別）:
+  //   線形+非線形: 減算器で フィルタ出力IFFT 1, 係数制約 IFFT+FFT 2, 残差のゼロ詰めFFT 1,
+  //               ここで y と e の窓付きFFT 2, 抑圧フィルタのIFFT 1 の計7回。
+  //               線形エコーのスペクトル S2_linear は減算器のフィルタ出力 S から取るので、
+  //               以前の Y - E の再計算は不要。減算器のゼロ詰めFFTは係数更新用、
+  //               窓付きFFTは抑圧用で窓が異なるため e はこの2回が必要。
+  //   非線形のみ: e = y なので E は Y をそのまま使い、窓付きFFT 1 と抑圧IFFT 1 の計2回（以前は3回）。
+  //   線形のみ  : 減算器の4回のみ。
+  //   レンダー無音: 線形フィルタの範囲（遅延合わせ後の直近 kFilterLengthBlocks ブロック）に
+  //               有音のレンダーがなければエコーはないので、変換は0回（ゲート有効時）。
   void ProcessCapture(
       bool delay_changed,
       RenderBuffer* render_buffer,
@@ -45,7 +61,6 @@ struct EchoRemover {
     std::array<float, kFftLengthBy2Plus1> Y2; // 入力信号のパワースペクトル
     std::array<float, kFftLengthBy2Plus1> E2; // 残差信号のパワースペクトル
     std::array<float, kFftLengthBy2Plus1> R2; // 残留エコー推定（パワースペクトル）
-    std::array<float, kFftLengthBy2Plus1> S2_linear; // 線形推定エコーのパワースペクトル
     FftData Y; // 入力信号のFFT
     FftData E; // 残差信号のFFT
     SubtractorOutput subtractor_output; // 減算器の処理結果
@@ -53,6 +68,8 @@ struct EchoRemover {
     std::span<const float> capture_view_const(capture_view.data(), capture_view.size());
 
     last_metrics_.valid = false;
+    last_metrics_.render_active =
+        render_buffer->ActiveRender(subtractor_.filter_.size_partitions_);
 
     if (delay_changed) {
       subtractor_.HandleEchoPathChange();
@@ -74,6 +91,11 @@ struct EchoRemover {
       return;  // yはそのまま
     }
 
+    if (enable_render_gating_ && !last_metrics_.render_active) {
+      BypassSilentRender(*render_buffer, capture);
+      return;
+    }
+
     if (enable_linear_filter_) {
       // 線形フィルタ有効
       subtractor_.Process(*render_buffer, *y, aec_state_, &subtractor_output);
@@ -97,11 +119,12 @@ struct EchoRemover {
     } else {
       // 線形無効: e = y として扱う（減算器は使わない）
       std::copy(capture_view.begin(), capture_view.end(), e.begin());
-      // 減算出力と同等のメトリクスを作る（e=y として扱う → 非収束）
+      // 減算出力と同等のメトリクスを作る（e=y として扱う → 非収束、線形エコー推定は0）
       for (size_t i = 0; i < subtractor_output.e.size(); ++i) {
         subtractor_output.e[i] = capture_view[i];
       }
       subtractor_output.ComputeMetrics(capture_view_const);
+      subtractor_output.S2.fill(0.f);
     }
 
     // 非線形用の共通前処理
@@ -110,19 +133,23 @@ struct EchoRemover {
       PaddedFft(capture_view_const, previous_block, &Y);
       std::copy(capture_view_const.begin(), capture_view_const.end(), y_old_.begin());
     }
-    {
+    if (enable_linear_filter_) {
       std::span<const float> previous_error_block(e_old_.data(), e_old_.size());
       std::span<const float> error_view(e.data(), e.size());
       PaddedFft(error_view, previous_error_block, &E);
       std::copy(error_view.begin(), error_view.end(), e_old_.begin());
+    } else {
+      // e = y なので変換し直さない。線形を再び有効にしたときのため e_old_ は更新しておく。
+      E = Y;
+      std::copy(e.begin(), e.end(), e_old_.begin());
     }
-    for (size_t k = 0; k < E.re.size(); ++k) {
-      const float real_diff = Y.re[k] - E.re[k];
-      const float imag_diff = Y.im[k] - E.im[k];
-      S2_linear[k] = real_diff * real_diff + imag_diff * imag_diff;
-    }
+    const std::array<float, kFftLengthBy2Plus1>& S2_linear = subtractor_output.S2;
     Y.Spectrum(Y2);
-    E.Spectrum(E2);
+    if (enable_linear_filter_) {
+      E.Spectrum(E2);
+    } else {
+      E2 = Y2;
+    }
     aec_state_.Update(E2, Y2);
 
     const FftData& Y_fft = aec_state_.UsableLinearEstimate() ? E : Y;
@@ -138,15 +165,9 @@ struct EchoRemover {
     suppression_filter_.ApplyGain(G, Y_fft, y);
 
     // Metrics snapshot
-    float erle_avg = 0.f;
-    {
-      const std::array<float, kFftLengthBy2Plus1>& erle = aec_state_.Erle();
-      for (size_t i = 0; i < erle.size(); ++i) erle_avg += erle[i];
-      erle_avg /= static_cast<float>(erle.size());
-    }
     last_metrics_.e2 = subtractor_output.e2;
     last_metrics_.y2 = subtractor_output.y2;
-    last_metrics_.erle_avg = erle_avg;
+    last_metrics_.erle_avg = AverageErle();
     last_metrics_.linear_usable = aec_state_.UsableLinearEstimate();
     float output_energy = 0.f;
     for (const float sample : capture_view) {
@@ -155,6 +176,45 @@ struct EchoRemover {
     last_metrics_.output_e2 = output_energy;
     last_metrics_.valid = true;
   }
+
+  // レンダー無音のブロックを e = y として素通しする。
+  // 線形フィルタ・係数更新・AEC状態・抑圧ゲインの計算は行わない（状態もそのまま保つ）。
+  // 非線形抑圧が有効なときの出力は、ゲイン1の抑圧フィルタと同じく1ブロック遅れになり、
+  // y_old_/e_old_ と重ね合わせ状態も更新するので、次の有音ブロックから通常処理へ継ぎ目なく戻る。
+  void BypassSilentRender(const RenderBuffer& render_buffer, Block* capture) {
+    if (enable_linear_filter_) {
+      subtractor_.Bypass(render_buffer);
+    }
+    float capture_energy = 0.f;
+    for (const float sample : *capture) {
+      capture_energy += sample * sample;
+    }
+    float output_energy = capture_energy;
+    if (enable_nonlinear_suppressor_) {
+      const Block y = *capture;
+      suppression_filter_.ApplyUnitGain(y_old_, y, capture);
+      std::copy(y.begin(), y.end(), y_old_.begin());
+      std::copy(y.begin(), y.end(), e_old_.begin());
+      output_energy = 0.f;
+      for (const float sample : *capture) {
+        output_energy += sample * sample;
+      }
+    }
+    last_metrics_.y2 = capture_energy;
+    last_metrics_.e2 = capture_energy;
+    last_metrics_.output_e2 = output_energy;
+    last_metrics_.erle_avg = AverageErle();
+    last_metrics_.linear_usable = aec_state_.UsableLinearEstimate();
+    last_metrics_.valid = true;
+  }
+
+  // AEC状態のERLE推定の全ビン平均（メトリクス用）。
+  float AverageErle() const {
+    const std::array<float, kFftLengthBy2Plus1>& erle = aec_state_.Erle();
+    float erle_avg = 0.f;
+    for (size_t i = 0; i < erle.size(); ++i) erle_avg += erle[i];
+    return erle_avg / static_cast<float>(erle.size());
+  }
   
 };
 
@@ -163,6 +223,7 @@ struct EchoRemover {
 //   2. 遅延推定(サンプル→ブロック)
 //   3. バッファのアラインメント(推定遅延が変化したら delay_changed=true)
 //   4. エコー除去本体
+//   5. 減算器の誤差を遅延推定器へ返す（追跡モードの解除判定、レンダー有音時のみ）
 inline void ProcessCaptureBlock(
     RenderDelayBuffer* render_buffer,
     EchoPathDelayEstimator* delay_estimator,
@@ -185,4 +246,9 @@ inline void ProcessCaptureBlock(
   echo_remover->ProcessCapture(delay_changed,
                                render_buffer->GetRenderBuffer(),
                                capture_block);
+  if (echo_remover->last_metrics_.valid &&
+      echo_remover->last_metrics_.render_active) {
+    delay_estimator->ObserveSubtractorError(echo_remover->last_metrics_.y2,
+                                            echo_remover->last_metrics_.e2);
+  }
 }
@@ -1,10 +1,16 @@
 // Echoback (C++): 最小構成のローカル・エコーバック + AEC3
 // 使い方:
-//   ./echoback [--passthrough] [--no-linear] [--no-nonlinear] [--latency-ms=N] [--loopback-delay-ms=N]
+//   ./echoback [--passthrough] [--no-linear] [--no-nonlinear] [--fft-delay] [--delay-tracking] [--latency-ms=N] [--loopback-delay-ms=N] [--worker-thread] [--pipeline-blocks=N]
 //   体感用のモード:
 //     --passthrough     : AEC無効（素通し）
 //     --no-linear       : 線形フィルタ無効（非線形のみ）
 //     --no-nonlinear    : 非線形抑圧無効（線形のみ）
+//     --fft-delay       : 遅延推定を周波数領域の相互相関で行う
+//     --delay-tracking  : 遅延が安定したら該当フィルタだけを追跡し、全探索を間引く
+//   実行モード:
+//     --worker-thread   : AEC処理をコールバックから専用スレッドへ移す（コールバックはキューの受け渡しのみ）
+//     --pipeline-blocks=N : ワーカーモードで出力側に先に積んでおくブロック数（既定2 = 8 ms）。
+//                         大きくすると遅延は増えるが、処理が一時的に遅れても音が途切れにくい
 //   ショートハンド:
 //     --linear-only     : = --no-nonlinear
 //     --nonlinear-only  : = --no-linear
@@ -16,6 +22,30 @@
 #include "all.h"
 
 #include "portaudio.h"
+#include <thread>
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <pthread.h>
+#else
+#include <semaphore.h>
+#endif
+
+// ワーカーを起こすセマフォ。Signal はロックもヒープ確保もしないのでオーディオコールバックから呼べる。
+// （std::atomic::wait は macOS 11 未満で使えないため、macOS では dispatch_semaphore を使う）
+struct WorkerSignal {
+#if defined(__APPLE__)
+  dispatch_semaphore_t sem_ = dispatch_semaphore_create(0);
+  ~WorkerSignal() { dispatch_release(sem_); }
+  void Signal() { dispatch_semaphore_signal(sem_); }
+  void Wait() { dispatch_semaphore_wait(sem_, DISPATCH_TIME_FOREVER); }
+#else
+  sem_t sem_;
+  WorkerSignal() { sem_init(&sem_, 0, 0); }
+  ~WorkerSignal() { sem_destroy(&sem_); }
+  void Signal() { sem_post(&sem_); }
+  void Wait() { while (sem_wait(&sem_) != 0) {} }
+#endif
+};
 
 struct State {
   int dev_sr = 16000;              // 16k固定
@@ -26,16 +56,20 @@ struct State {
   int loopback_delay_ms = 150;      // 遠端へ送る経路に加える遅延（ms）
   size_t loopback_delay_samples = 0;
 
-  // デバイスサンプリング周波数 (dev_sr) で動作するFIFO群
-  std::deque<int16_t> rec_dev;     // マイクから収音したサンプル
-  std::deque<int16_t> out_dev;     // スピーカーへ送るサンプル
+  // デバイスサンプリング周波数 (dev_sr) で動作するFIFO群。
+  // すべて固定容量のSPSCリングで、コールバック内ではヒープ確保をしない。
+  // 遅延系の容量は引数の上限（10000 ms 未満）に数ブロックの余裕を足したもの。
+  inline static constexpr size_t kDeviceFifoSamples = 16000;          // 1秒分
+  inline static constexpr size_t kMaxDelaySamples = 16000 * 10 + 4 * kBlockSize;
+  SpscRing<int16_t> rec_dev{kDeviceFifoSamples};   // マイクから収音したサンプル
+  SpscRing<int16_t> out_dev{kDeviceFifoSamples};   // スピーカーへ送るサンプル
 
   // AEC3 ドメイン = デバイスドメイン（同一サンプリング）。64 サンプル単位で処理
-  std::deque<int16_t> ref_fifo;    // 直前に処理したブロック（ローカルエコー参照）
-  std::deque<int16_t> loopback_delay_line; // 遠端に送るまで保持する遅延ライン
+  SpscRing<int16_t> ref_fifo{2 * kBlockSize};      // 直前に処理したブロック（ローカルエコー参照）
+  SpscRing<int16_t> loopback_delay_line{kMaxDelaySamples}; // 遠端に送るまで保持する遅延ライン
 
   // ジッタバッファ（デバイスドメイン）。ローカルエコーパスを蓄積しスピーカーへ混ぜる
-  std::deque<int16_t> jitter;      // ループバック遅延を模擬するため処理済み音を蓄積
+  SpscRing<int16_t> jitter{kMaxDelaySamples};      // ループバック遅延を模擬するため処理済み音を蓄積
   bool need_jitter = true;
 
   // MatchedFilter による推定遅延の前回ログ値（ブロック数）。
@@ -45,6 +79,21 @@ struct State {
   // --passthrough: AEC を行わず素通し再生
   bool passthrough = false;
 
+  // --worker-thread: コールバックは rec_dev へ書いて out_dev から読むだけで、AEC処理はワーカーが行う。
+  // rec_dev はコールバック→ワーカー、out_dev はワーカー→コールバックのSPSCリングになり、
+  // それ以外のFIFOと AEC3 の状態はワーカーだけが触る。
+  bool worker_mode = false;
+  size_t pipeline_blocks = 2;               // 出力側に先積みする無音ブロック数（パイプラインの深さ）
+  WorkerSignal capture_signal;              // コールバックが収音を積むたびに鳴らし、ワーカーを起こす
+  std::atomic<bool> worker_stop{false};
+  size_t underrun_debt = 0;                 // アンダーランで出せなかったサンプル数（コールバック専用）
+  // 計測値（コールバックが更新し、メインスレッドが1秒ごとに読み出す）
+  std::atomic<uint64_t> underruns{0};       // 出力が間に合わず無音で埋めたコールバック数
+  std::atomic<uint64_t> overruns{0};        // rec_dev が満杯で収音を捨てたコールバック数
+  std::atomic<uint64_t> latency_sum{0};     // 収音から出力までの遅延（サンプル）の合計
+  std::atomic<uint64_t> latency_count{0};
+  std::atomic<uint64_t> latency_max{0};     // メインスレッドが exchange(0) で読み出すので比較交換で更新する
+
   // 1秒平均キャンセル量（ERLE相当）の集計
   double erle_in_energy_accum = 0.0;
   double erle_linear_energy_accum = 0.0;
@@ -65,31 +114,21 @@ static void aec3_init_at_sr(State& s){
   s.block_size = 64;
 }
 
-static size_t pop_samples(std::deque<int16_t>& q, int16_t* dst, size_t n){
-  size_t m = q.size()<n ? q.size() : n;
-  for (size_t i=0;i<m;i++){ dst[i]=q.front(); q.pop_front(); }
-  return m;
-}
-
-static void push_block(std::deque<int16_t>& q, const int16_t* src, size_t n){
-  for (size_t i=0;i<n;i++) q.push_back(src[i]);
-}
-
 static void process_available_blocks(State& s){
-  // 可能なかぎり多くの 64 サンプルブロックを処理する
-  while (s.rec_dev.size() >= (size_t)s.block_size) {
-    std::vector<int16_t> rec(s.block_size), ref(s.block_size), out(s.block_size);
+  // 可能なかぎり多くの 64 サンプルブロックを処理する（作業領域はスタック上の固定長配列）
+  std::array<int16_t, kBlockSize> rec, ref, out, looped, mixed;
+  while (s.rec_dev.Size() >= kBlockSize) {
     // 入力（rec）ブロックを取り出す
-    pop_samples(s.rec_dev, rec.data(), s.block_size);
+    s.rec_dev.Read(rec);
     // 参照（ref）ブロックを取り出す（不足時はゼロ埋め）
-    if (s.ref_fifo.size() >= (size_t)s.block_size) {
-      pop_samples(s.ref_fifo, ref.data(), s.block_size);
+    if (s.ref_fifo.Size() >= kBlockSize) {
+      s.ref_fifo.Read(ref);
     } else {
-      std::memset(ref.data(), 0, s.block_size*sizeof(int16_t));
+      ref.fill(0);
     }
     if (s.passthrough) {
       // AEC を通さず、そのまま出力へ
-      std::memcpy(out.data(), rec.data(), s.block_size * sizeof(int16_t));
+      out = rec;
     } else {
       // AEC3 直結: Render/ Capture を渡して処理
       CopyFromPcm16(rec.data(), &s.cap_block);
@@ -138,31 +177,38 @@ static void process_available_blocks(State& s){
     }
 
     // echoback.js と同様に、次フレーム以降の参照として保存（処理後データを再利用）
-    push_block(s.ref_fifo, out.data(), s.block_size);
+    s.ref_fifo.Write(out);
 
     // ループバック遅延ラインを通して遠端へ送る信号を取得
-    std::vector<int16_t> looped(s.block_size);
-    push_block(s.loopback_delay_line, out.data(), s.block_size);
-    size_t forwarded = pop_samples(s.loopback_delay_line, looped.data(), s.block_size);
-    if (forwarded < static_cast<size_t>(s.block_size)) {
-      std::memset(looped.data() + forwarded, 0,
-                  (s.block_size - forwarded) * sizeof(int16_t));
-    }
+    s.loopback_delay_line.Write(out);
+    size_t forwarded = s.loopback_delay_line.Read(looped);
+    std::fill(looped.begin() + forwarded, looped.end(), 0);
 
     // ネットワークの代わりにローカル蓄積へ積む（エコーバック）
-    push_block(s.jitter, looped.data(), s.block_size);
-    if (s.need_jitter && s.jitter.size() > s.latency_samples) {
+    s.jitter.Write(looped);
+    if (s.need_jitter && s.jitter.Size() > s.latency_samples) {
       s.need_jitter = false; // jitter満了
     }
 
     // 受信（ローカル蓄積）を混ぜて再生用フレームを生成
-    std::vector<int16_t> mixed(s.block_size);
-    if (!s.need_jitter && s.jitter.size() >= (size_t)s.block_size) {
-      pop_samples(s.jitter, mixed.data(), s.block_size);
+    if (!s.need_jitter && s.jitter.Size() >= kBlockSize) {
+      s.jitter.Read(mixed);
     } else {
-      std::memset(mixed.data(), 0, s.block_size*sizeof(int16_t));
+      mixed.fill(0);
     }
-    push_block(s.out_dev, mixed.data(), s.block_size);
+    s.out_dev.Write(mixed);
+  }
+}
+
+// --worker-thread 用のAEC処理スレッド。収音が積まれるたびに起こされ、溜まったブロックを処理する。
+static void aec_worker(State* s){
+#if defined(__APPLE__)
+  pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+#endif
+  while (!s->worker_stop.load(std::memory_order_acquire)) {
+    // セマフォは回数を数えるので、処理中に積まれた分があれば Wait は即座に戻る
+    process_available_blocks(*s);
+    s->capture_signal.Wait();
   }
 }
 
@@ -176,18 +222,42 @@ static int pa_callback(const void* inputBuffer,
   const int16_t* in = reinterpret_cast<const int16_t*>(inputBuffer);
   int16_t* out = reinterpret_cast<int16_t*>(outputBuffer);
   const unsigned long n = blockSize; // モノラルのフレーム数（framesPerBuffer）
-  // Single-threaded実行のため終了フラグは不要
+  // 終了はメインスレッドがストリームを止めてから行うので、ここでは終了フラグを見ない
 
   // 1) キャプチャデータをキューへ格納
-  if (in) { for (unsigned long i=0;i<n;i++) st->rec_dev.push_back(in[i]); }
+  if (in && st->rec_dev.Write(std::span<const int16_t>(in, n)) < n) {
+    st->overruns.fetch_add(1, std::memory_order_relaxed);
+  }
 
-  // 2) 準備が整っている分だけ AEC3 を実行
-  process_available_blocks(*st);
+  // 2) 準備が整っている分だけ AEC3 を実行（ワーカーモードではワーカーを起こすだけ）
+  if (st->worker_mode) {
+    st->capture_signal.Signal();
+  } else {
+    process_available_blocks(*st);
+  }
 
-  // 3) 出力を生成
-  for (unsigned long i=0;i<n;i++){
-    if (!st->out_dev.empty()){ out[i]=st->out_dev.front(); st->out_dev.pop_front(); }
-    else { out[i]=0; }
+  // 3) 出力を生成。ワーカーモードでアンダーランした分は、遅れて届いたときに捨てて
+  //    遅延がパイプラインの深さより伸びたままにならないようにする
+  if (st->underrun_debt > 0) {
+    const size_t drop = std::min(st->underrun_debt, st->out_dev.Size());
+    st->out_dev.Discard(drop);
+    st->underrun_debt -= drop;
+  }
+  const size_t got = st->out_dev.Read(std::span<int16_t>(out, n));
+  std::fill(out + got, out + n, 0);
+  if (st->worker_mode) {
+    if (got < n) {
+      st->underruns.fetch_add(1, std::memory_order_relaxed);
+      st->underrun_debt += n - got;
+    }
+    // いま収音したサンプルが出力されるまでに前にあるサンプル数（未処理 + 処理済み未出力）
+    const uint64_t latency = st->rec_dev.Size() + st->out_dev.Size();
+    st->latency_sum.fetch_add(latency, std::memory_order_relaxed);
+    st->latency_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev_max = st->latency_max.load(std::memory_order_relaxed);
+    while (latency > prev_max &&
+           !st->latency_max.compare_exchange_weak(prev_max, latency, std::memory_order_relaxed)) {
+    }
   }
   return paContinue;
 }
@@ -200,6 +270,8 @@ int main(int argc, char** argv){
   // 引数パース
   bool no_linear = false;
   bool no_nonlinear = false;
+  bool fft_delay = false;
+  bool delay_tracking = false;
   for (int i = 1; i < argc; ++i) {
     std::string arg(argv[i] ? argv[i] : "");
     if (arg == "--passthrough" || arg == "-p") {
@@ -208,13 +280,28 @@ int main(int argc, char** argv){
       no_linear = true;
     } else if (arg == "--no-nonlinear") {
       no_nonlinear = true;
+    } else if (arg == "--fft-delay") {
+      fft_delay = true;
+    } else if (arg == "--delay-tracking") {
+      delay_tracking = true;
+    } else if (arg == "--worker-thread") {
+      s.worker_mode = true;
+    } else if (arg.rfind("--pipeline-blocks=", 0) == 0) {
+      const char* value = arg.c_str() + std::strlen("--pipeline-blocks=");
+      char* endp = nullptr;
+      long v = std::strtol(value, &endp, 10);
+      if (endp && *endp == '\0' && v >= 1 && v <= 64) {
+        s.pipeline_blocks = static_cast<size_t>(v);
+      } else {
+        std::fprintf(stderr, "Invalid --pipeline-blocks value: %s (ignored)\n", value);
+      }
     } else if (arg == "--linear-only") {
       no_nonlinear = true; no_linear = false;
     } else if (arg == "--nonlinear-only") {
       no_linear = true; no_nonlinear = false;
     } else if (arg == "--help" || arg == "-h") {
       std::fprintf(stderr,
-                   "Usage: %s [--passthrough] [--no-linear] [--no-nonlinear] [--latency-ms=N] [--loopback-delay-ms=N]\n",
+                   "Usage: %s [--passthrough] [--no-linear] [--no-nonlinear] [--fft-delay] [--delay-tracking] [--latency-ms=N] [--loopback-delay-ms=N] [--worker-thread] [--pipeline-blocks=N]\n",
                    argv[0]);
       return 0;
     } else if (arg == "--latency-ms") {
@@ -270,11 +357,17 @@ int main(int argc, char** argv){
   s.latency_samples = (size_t)((long long)s.dev_sr * s.latency_ms / 1000);
   s.loopback_delay_samples = (size_t)((long long)s.dev_sr * s.loopback_delay_ms / 1000);
   if (s.loopback_delay_samples > 0) {
-    s.loopback_delay_line = std::deque<int16_t>(s.loopback_delay_samples, 0);
+    const std::array<int16_t, kBlockSize> silence{};
+    for (size_t filled = 0; filled < s.loopback_delay_samples; ) {
+      const size_t n = std::min(silence.size(), s.loopback_delay_samples - filled);
+      filled += s.loopback_delay_line.Write(std::span<const int16_t>(silence.data(), n));
+    }
   }
   // AECモード設定（passthrough時は意味なし）
   if (!s.passthrough) {
     s.echo_remover.SetProcessingModes(!no_linear, !no_nonlinear);
+    s.delay_estimator.SetFftMatchedFilter(fft_delay);
+    s.delay_estimator.SetLowPowerTracking(delay_tracking);
   }
   const char* mode = s.passthrough ? "passthrough" :
                      (no_linear && !no_nonlinear) ? "nonlinear-only" :
@@ -285,6 +378,15 @@ int main(int argc, char** argv){
                 mode, s.latency_ms, s.latency_samples,
                 s.loopback_delay_ms, s.loopback_delay_samples);
   aec3_init_at_sr(s);
+  if (s.worker_mode) {
+    std::fprintf(stderr, "worker thread: pipeline_blocks=%zu (%zu ms)\n",
+                 s.pipeline_blocks, s.pipeline_blocks * 1000 / kNumBlocksPerSecond);
+    // パイプラインの深さ分だけ無音を先に積み、ワーカーの処理時間をこの範囲で吸収する
+    const std::array<int16_t, kBlockSize> silence{};
+    for (size_t b = 0; b < s.pipeline_blocks; ++b) {
+      s.out_dev.Write(silence);
+    }
+  }
 
   PaError err = Pa_Initialize();
   if (err!=paNoError){ std::fprintf(stderr, "Pa_Initialize error %s\n", Pa_GetErrorText(err)); return 1; }
@@ -300,14 +402,42 @@ int main(int argc, char** argv){
 
   err = Pa_OpenStream(&stream, &inP, &outP, s.dev_sr, s.block_size, paClipOff, pa_callback, &s);
   if (err!=paNoError){ std::fprintf(stderr, "Pa_OpenStream error %s\n", Pa_GetErrorText(err)); Pa_Terminate(); return 1; }
+  // ワーカーはストリーム開始前に起動しておく（先積みした出力が尽きる前に処理を始めるため）
+  std::thread worker;
+  if (s.worker_mode) {
+    worker = std::thread(aec_worker, &s);
+  }
+  auto stop_worker = [&s, &worker]() {
+    if (!worker.joinable()) return;
+    s.worker_stop.store(true, std::memory_order_release);
+    s.capture_signal.Signal();
+    worker.join();
+  };
   err = Pa_StartStream(stream);
-  if (err!=paNoError){ std::fprintf(stderr, "Pa_StartStream error %s\n", Pa_GetErrorText(err)); Pa_CloseStream(stream); Pa_Terminate(); return 1; }
+  if (err!=paNoError){ std::fprintf(stderr, "Pa_StartStream error %s\n", Pa_GetErrorText(err)); stop_worker(); Pa_CloseStream(stream); Pa_Terminate(); return 1; }
 
   std::fprintf(stderr, "Running... Ctrl-C to stop.\n");
+  int report_ticks = 0;
   while (Pa_IsStreamActive(stream)==1) {
     Pa_Sleep(100);
+    if (s.worker_mode && ++report_ticks >= 10) {
+      // 1秒ごとにワーカーモードの遅延と取りこぼしを報告する
+      report_ticks = 0;
+      const uint64_t count = s.latency_count.exchange(0);
+      const uint64_t sum = s.latency_sum.exchange(0);
+      const uint64_t max = s.latency_max.exchange(0);
+      const double avg_ms = count ? 1000.0 * sum / count / s.dev_sr : 0.0;
+      const double max_ms = 1000.0 * max / s.dev_sr;
+      std::fprintf(stderr,
+                   "[worker] 収音→出力の遅延: 平均=%.1f ms, 最大=%.1f ms, アンダーラン=%llu, オーバーラン=%llu (累計)\n",
+                   avg_ms, max_ms,
+                   static_cast<unsigned long long>(s.underruns.load()),
+                   static_cast<unsigned long long>(s.overruns.load()));
+    }
   }
-  Pa_StopStream(stream); Pa_CloseStream(stream); Pa_Terminate();
+  Pa_StopStream(stream); Pa_CloseStream(stream);
+  stop_worker();
+  Pa_Terminate();
   std::fprintf(stderr, "stopped.\n");
   return 0;
 }
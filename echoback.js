@@ -79,12 +79,17 @@ const kBlocksPerSec = 250;
 const latencySamplesTarget = Math.floor((kSr * latencyMs) / 1000);
 const loopbackDelaySamplesTarget = Math.floor((kSr * loopbackDelayMs) / 1000);
 
-// PAmac.node
-let PortAudio = null;
-if (process.platform === 'darwin') {
-  PortAudio = require('./PAmac.node');
-} else {
-  console.error('Only macOS (PAmac.node) is supported here.');
+// PortAudio: PANode build (N-API / V8) if built, else the prebuilt PAmac.node
+function loadPortAudio() {
+  for (const p of ['./PANode/build/Release/PA_napi.node', './PANode/build/Release/PA.node']) {
+    try { return require(p); } catch {}
+  }
+  if (process.platform === 'darwin') return require('./PAmac.node');
+  return null;
+}
+const PortAudio = loadPortAudio();
+if (!PortAudio) {
+  console.error('PortAudio binding not found (build PANode, or use PAmac.node on macOS).');
   process.exit(1);
 }
 
@@ -95,15 +100,6 @@ PortAudio.startSpeaker();
 // AEC3 WASM
 const AEC3Module = require('./dist/aec3_wasm.js');
 
-// Small FIFO helpers
-function pushArray(dstArr, src) { for (let i = 0; i < src.length; i++) dstArr.push(src[i]|0); }
-function popBlockI16(arr) {
-  if (arr.length < kBlock) return null;
-  const out = new Int16Array(kBlock);
-  for (let i = 0; i < kBlock; i++) out[i] = arr.shift();
-  return out;
-}
-
 function toInt16Array(x) {
   if (!x) return new Int16Array();
   if (ArrayBuffer.isView(x)) {
@@ -120,6 +116,23 @@ function toInt16Array(x) {
   return out;
 }
 
+// Move whole blocks of newly recorded mic samples (at most maxSamples) to HEAP16[dst...] and return the count.
+function readMic(mod, dst, maxSamples) {
+  if (typeof PortAudio.readRecordedSamples === 'function') {
+    // the native side copies straight into the WASM heap
+    return PortAudio.readRecordedSamples(mod.HEAP16.subarray(dst, dst + maxSamples), kBlock);
+  }
+  const recArr = toInt16Array(PortAudio.getRecordedSamples());
+  let n = Math.min(recArr.length, maxSamples);
+  n -= n % kBlock;
+  mod.HEAP16.set(recArr.subarray(0, n), dst);
+  // consume from PAmac buffer (what was not taken stays there)
+  if (n > 0 && typeof PortAudio.discardRecordedSamples === 'function') {
+    PortAudio.discardRecordedSamples(n);
+  }
+  return n;
+}
+
 (async () => {
   const mod = await AEC3Module();
 
@@ -129,102 +142,101 @@ function toInt16Array(x) {
     mod._aec3_set_modes(h, enableLinear ? 1 : 0, enableNonlinear ? 1 : 0);
   }
 
-  const bytes = kBlock * 2;
-  const pRef = mod._malloc(bytes);
-  const pCap = mod._malloc(bytes);
-  const pOut = mod._malloc(bytes);
-
-  let recQ = [];
-  let refQ = [];
-  let jitterQ = [];
-  let loopbackDelayLine = loopbackDelaySamplesTarget > 0 ? new Array(loopbackDelaySamplesTarget).fill(0) : [];
-  let needJitter = true;
+  // Everything stays in the WASM heap (indices are HEAP16 indices; always go through mod.HEAP16,
+  // the heap may grow):
+  // - cap: up to kBatchBlocks mic blocks, read straight from PortAudio
+  // - ring: the processed output stream. aec3_process_frames writes into it, its render input is
+  //   the output from kBatchBlocks blocks earlier in the same ring, and the speaker plays it
+  //   loopback + jitter delay later. The render reference thus lags the output by kBatchBlocks
+  //   blocks (the delay estimator absorbs that), so a whole batch can be processed in one call.
+  const kBatchBlocks = 4;
+  const playDelaySamples = loopbackDelaySamplesTarget + kBlock * Math.floor(latencySamplesTarget / kBlock);
+  const ringSamples = kBlock * (Math.ceil(playDelaySamples / kBlock) + 2 * kBatchBlocks + 1);
+  const pCap = mod._malloc(kBatchBlocks * kBlock * 2);
+  const pRing = mod._malloc(ringSamples * 2);
+  const capBase = pCap >> 1, ringBase = pRing >> 1;
+  mod.HEAP16.fill(0, ringBase, ringBase + ringSamples);
+  let writePos = 0; // next block in the ring (always a multiple of kBlock)
+  // older PAmac.node ignores view offsets, so it gets each block copied into a whole array
+  const playViews = typeof PortAudio.readRecordedSamples === 'function';
+  const mixed = new Int16Array(kBlock);
   let lastDelay = -2; // -2: uninitialized, -1: no estimate
 
   let erleIn = 0.0, erleOut = 0.0, erleBlocks = 0;
 
   console.error(`echoback (16k mono): mode=${passthrough ? 'passthrough' : (enableLinear && enableNonlinear ? 'aec3' : (!enableLinear ? 'nonlinear-only' : 'linear-only'))}, latency_ms=${latencyMs} (samples=${latencySamplesTarget}), loopback_delay_ms=${loopbackDelayMs} (samples=${loopbackDelaySamplesTarget})`);
 
+  // Queue the 64 ring samples starting at pos for the speaker (two parts when they wrap around).
+  function playBlock(pos) {
+    const first = Math.min(kBlock, ringSamples - pos);
+    const heap = mod.HEAP16;
+    if (playViews) {
+      PortAudio.pushSamplesForPlay(heap.subarray(ringBase + pos, ringBase + pos + first));
+      if (first < kBlock) PortAudio.pushSamplesForPlay(heap.subarray(ringBase, ringBase + kBlock - first));
+    } else {
+      mixed.set(heap.subarray(ringBase + pos, ringBase + pos + first));
+      if (first < kBlock) mixed.set(heap.subarray(ringBase, ringBase + kBlock - first), first);
+      PortAudio.pushSamplesForPlay(mixed);
+    }
+  }
+
+  // Process nb mic blocks from cap[capOff...] into the ring at writePos, rendering from renderPos
+  // (neither span wraps around: the caller splits at the end of the ring).
+  function processChunk(capOff, renderPos, nb) {
+    if (passthrough) {
+      mod.HEAP16.copyWithin(ringBase + writePos, capBase + capOff, capBase + capOff + nb * kBlock);
+      return;
+    }
+    mod._aec3_process_frames(h, pRing + renderPos * 2, pCap + capOff * 2, pRing + writePos * 2, nb);
+
+    // delay logging
+    const dblk = mod._aec3_get_estimated_delay_blocks(h);
+    if (dblk >= 0 && dblk !== lastDelay) {
+      const ms = Math.floor(dblk * 1000 / kBlocksPerSec);
+      console.error(`[AEC3] 推定遅延が変化: ${dblk} ブロック (約 ${ms} ms)`);
+      lastDelay = dblk;
+    }
+
+    // ERLE-approx logging once per second
+    const heap = mod.HEAP16;
+    let ein = 0, eout = 0;
+    for (let i = 0; i < nb * kBlock; i++) {
+      const x = heap[capBase + capOff + i]; const y = heap[ringBase + writePos + i]; ein += x*x; eout += y*y;
+    }
+    erleIn += ein; erleOut += eout; erleBlocks += nb;
+    if (erleBlocks >= kBlocksPerSec) {
+      const ratio = (erleIn + 1e-9) / (erleOut + 1e-9);
+      const erleDb = 10 * Math.log10(ratio);
+      console.error(`[AEC3] 1秒平均キャンセル量: ${erleDb.toFixed(1)} dB`);
+      erleIn = erleOut = 0; erleBlocks = 0;
+    }
+  }
+
   function processBlocks() {
-    // run as many 64-sample blocks as we can
+    // run as many 64-sample blocks as we can, up to kBatchBlocks per call
     let producedBlocks = 0;
     for (;;) {
-      if (recQ.length < kBlock) break;
-      const rec = popBlockI16(recQ);
-      let ref = null;
-      if (refQ.length >= kBlock) ref = popBlockI16(refQ); else ref = new Int16Array(kBlock);
-
-      let out;
-      if (passthrough) {
-        out = rec;
-      } else {
-        // copy to HEAP and run
-        mod.HEAP16.set(ref, pRef >> 1);
-        mod.HEAP16.set(rec, pCap >> 1);
-        mod._aec3_analyze(h, pRef);
-        mod._aec3_process(h, pCap, pOut);
-        out = mod.HEAP16.subarray(pOut >> 1, (pOut >> 1) + kBlock);
-        // clone because subarray view is tied to wasm memory
-        out = new Int16Array(out);
-
-        // delay logging
-        const dblk = mod._aec3_get_estimated_delay_blocks(h);
-        if (dblk >= 0 && dblk !== lastDelay) {
-          const ms = Math.floor(dblk * 1000 / kBlocksPerSec);
-          console.error(`[AEC3] 推定遅延が変化: ${dblk} ブロック (約 ${ms} ms)`);
-          lastDelay = dblk;
-        }
-
-        // ERLE-approx logging once per second
-        let ein = 0, eout = 0;
-        for (let i = 0; i < kBlock; i++) { const x = rec[i]; const y = out[i]; ein += x*x; eout += y*y; }
-        erleIn += ein; erleOut += eout; erleBlocks += 1;
-        if (erleBlocks >= kBlocksPerSec) {
-          const ratio = (erleIn + 1e-9) / (erleOut + 1e-9);
-          const erleDb = 10 * Math.log10(ratio);
-          console.error(`[AEC3] 1秒平均キャンセル量: ${erleDb.toFixed(1)} dB`);
-          erleIn = erleOut = 0; erleBlocks = 0;
+      const nb = readMic(mod, capBase, kBatchBlocks * kBlock) / kBlock;
+      if (nb === 0) break;
+      for (let b = 0; b < nb;) {
+        const renderPos = (writePos + ringSamples - kBatchBlocks * kBlock) % ringSamples;
+        const n = Math.min(nb - b, (ringSamples - writePos) / kBlock, (ringSamples - renderPos) / kBlock);
+        processChunk(b * kBlock, renderPos, n);
+        for (let k = 0; k < n; k++) {
+          // speaker block: the output playDelaySamples earlier (silence until the ring has it)
+          playBlock((writePos + ringSamples - playDelaySamples) % ringSamples);
+          writePos = (writePos + kBlock) % ringSamples;
         }
+        b += n;
       }
-
-      // 参照キューには遅延なしの処理済みブロックを入れる
-      for (let i = 0; i < kBlock; i++) refQ.push(out[i]);
-
-      // simulate loopback path delay before the signal returns locally
-      for (let i = 0; i < kBlock; i++) loopbackDelayLine.push(out[i]);
-      let looped = popBlockI16(loopbackDelayLine);
-      if (!looped) looped = new Int16Array(kBlock);
-
-      // accumulate to local jitter after loopback delay
-      for (let i = 0; i < kBlock; i++) jitterQ.push(looped[i]);
-      if (needJitter && jitterQ.length > latencySamplesTarget) needJitter = false;
-
-      // produce speaker block from jitter
-      let mixed = new Int16Array(kBlock);
-      if (!needJitter && jitterQ.length >= kBlock) {
-        for (let i = 0; i < kBlock; i++) mixed[i] = jitterQ.shift();
-      } else {
-        // silence until jitter filled
-        mixed.fill(0);
-      }
-      PortAudio.pushSamplesForPlay(mixed);
-      producedBlocks++;
+      producedBlocks += nb;
+      if (nb < kBatchBlocks) break;
     }
     return producedBlocks;
   }
 
   const tickMs = 4; // 64 / 16000 * 1000
   const timer = setInterval(() => {
-    // fetch mic samples
-    const recBuf = PortAudio.getRecordedSamples();
-    const recArr = toInt16Array(recBuf);
-    if (recArr.length > 0) {
-      pushArray(recQ, recArr);
-      // consume from PAmac buffer
-      if (typeof PortAudio.discardRecordedSamples === 'function') {
-        PortAudio.discardRecordedSamples(recArr.length);
-      }
-    }
     processBlocks();
   }, tickMs);
 
@@ -232,7 +244,7 @@ function toInt16Array(x) {
     clearInterval(timer);
     try { PortAudio && PortAudio.stopMic && PortAudio.stopMic(); } catch {}
     try { PortAudio && PortAudio.stopSpeaker && PortAudio.stopSpeaker(); } catch {}
-    mod._free(pRef); mod._free(pCap); mod._free(pOut);
+    mod._free(pCap); mod._free(pRing);
     mod._aec3_destroy(h);
   }
 
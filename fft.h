@@ -32,6 +32,58 @@ struct OouraFft {
         -0.995184720f, -0.098017156f, -0.290284693f, -0.956940353f,
     };
 
+    // SIMD版で使うツイドル係数。1ベクトルに2つの複素数 [re, im, re, im] を詰めるので、
+    // wkr = [wr, wr, ...], wki = [-wi, wi, ...] と並べておけば複素乗算は wkr*x + wki*swap(x) になる。
+    // 添字 [0..2] は wk1, wk2, wk3。cft1st は16要素グループごと(前半/後半の2複素数)、
+    // cftmdl は32要素ブロックごと(同じ係数の2複素数)に4要素ずつ並ぶ。
+    alignas(16) float cft1st_wkr[3][32];
+    alignas(16) float cft1st_wki[3][32];
+    alignas(16) float cftmdl_wkr[3][16];
+    alignas(16) float cftmdl_wki[3][16];
+
+    // スカラー版の係数表からSIMD用の係数表を生成する。
+    OouraFft() {
+        // グループ g (k1 = 2g) の前半(half=0)/後半(half=1)で使う wk1, wk2, wk3。
+        // 後半の wk2 はスカラー版の (-wk2i, wk2r) に相当する。
+        auto twiddle = [this](int g, int half, int t, float* wr, float* wi) {
+            const int k1 = 2 * g;
+            const int k2 = 2 * k1;
+            if (t == 0) {
+                *wr = rdft_w[k2 + 2 * half + 0];
+                *wi = rdft_w[k2 + 2 * half + 1];
+            } else if (t == 1) {
+                *wr = half ? -rdft_w[k1 + 1] : rdft_w[k1 + 0];
+                *wi = half ? rdft_w[k1 + 0] : rdft_w[k1 + 1];
+            } else {
+                const float* wk3 = half ? rdft_wk3ri_second : rdft_wk3ri_first;
+                *wr = wk3[k1 + 0];
+                *wi = wk3[k1 + 1];
+            }
+        };
+        for (int t = 0; t < 3; ++t) {
+            for (int g = 0; g < 8; ++g) {
+                for (int half = 0; half < 2; ++half) {
+                    float wr, wi;
+                    twiddle(g, half, t, &wr, &wi);
+                    const int i = 4 * g + 2 * half;
+                    cft1st_wkr[t][i + 0] = wr;
+                    cft1st_wkr[t][i + 1] = wr;
+                    cft1st_wki[t][i + 0] = -wi;
+                    cft1st_wki[t][i + 1] = wi;
+                    if (g < 2) {
+                        const int b = 4 * (2 * g + half);
+                        for (int k = 0; k < 4; k += 2) {
+                            cftmdl_wkr[t][b + k + 0] = wr;
+                            cftmdl_wkr[t][b + k + 1] = wr;
+                            cftmdl_wki[t][b + k + 0] = -wi;
+                            cftmdl_wki[t][b + k + 1] = wi;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
     inline void cft1st_128_C(float* a) const {
         const int n = 128;
         int j, k1, k2;
@@ -310,6 +362,467 @@ struct OouraFft {
         a[65] = -a[65];
     }
 
+#if defined(__ARM_NEON)
+    // NEON版。各ベクトルは [re, im, re, im] の2複素数を保持する。
+    static inline float32x4_t CMul_NEON(float32x4_t wkr, float32x4_t wki, float32x4_t x) {
+        return vaddq_f32(vmulq_f32(wkr, x), vmulq_f32(wki, vrev64q_f32(x)));
+    }
+
+    static inline float32x4_t Reverse_NEON(float32x4_t v) {
+        const float32x4_t r = vrev64q_f32(v);
+        return vcombine_f32(vget_high_f32(r), vget_low_f32(r));
+    }
+
+    // cft1st/cftmdl 共通の基数4バタフライ。wkr/wki は wk1 の係数位置、stride で wk2, wk3 へ進む。
+    static inline void Radix4_NEON(const float* wkr, const float* wki, int stride,
+                                   float32x4_t* v0, float32x4_t* v1,
+                                   float32x4_t* v2, float32x4_t* v3) {
+        const float32x4_t sign = {-1.f, 1.f, -1.f, 1.f};
+        const float32x4_t x0 = vaddq_f32(*v0, *v1);
+        const float32x4_t x1 = vsubq_f32(*v0, *v1);
+        const float32x4_t x2 = vaddq_f32(*v2, *v3);
+        const float32x4_t x3 = vsubq_f32(*v2, *v3);
+        // [-x3i, x3r]
+        const float32x4_t x3w = vmulq_f32(sign, vrev64q_f32(x3));
+        *v0 = vaddq_f32(x0, x2);
+        *v1 = CMul_NEON(vld1q_f32(wkr), vld1q_f32(wki), vaddq_f32(x1, x3w));
+        *v2 = CMul_NEON(vld1q_f32(wkr + stride), vld1q_f32(wki + stride),
+                        vsubq_f32(x0, x2));
+        *v3 = CMul_NEON(vld1q_f32(wkr + 2 * stride), vld1q_f32(wki + 2 * stride),
+                        vsubq_f32(x1, x3w));
+    }
+
+    inline void cft1st_128_NEON(float* a) const {
+        for (int j = 0, k = 0; j < 128; j += 16, k += 4) {
+            const float32x4_t a00 = vld1q_f32(&a[j + 0]);
+            const float32x4_t a04 = vld1q_f32(&a[j + 4]);
+            const float32x4_t a08 = vld1q_f32(&a[j + 8]);
+            const float32x4_t a12 = vld1q_f32(&a[j + 12]);
+            float32x4_t v0 = vcombine_f32(vget_low_f32(a00), vget_low_f32(a08));
+            float32x4_t v1 = vcombine_f32(vget_high_f32(a00), vget_high_f32(a08));
+            float32x4_t v2 = vcombine_f32(vget_low_f32(a04), vget_low_f32(a12));
+            float32x4_t v3 = vcombine_f32(vget_high_f32(a04), vget_high_f32(a12));
+            Radix4_NEON(&cft1st_wkr[0][k], &cft1st_wki[0][k], 32, &v0, &v1, &v2, &v3);
+            vst1q_f32(&a[j + 0], vcombine_f32(vget_low_f32(v0), vget_low_f32(v1)));
+            vst1q_f32(&a[j + 4], vcombine_f32(vget_low_f32(v2), vget_low_f32(v3)));
+            vst1q_f32(&a[j + 8], vcombine_f32(vget_high_f32(v0), vget_high_f32(v1)));
+            vst1q_f32(&a[j + 12], vcombine_f32(vget_high_f32(v2), vget_high_f32(v3)));
+        }
+    }
+
+    inline void cftmdl_128_NEON(float* a) const {
+        for (int b = 0; b < 4; ++b) {
+            for (int j0 = 32 * b; j0 < 32 * b + 8; j0 += 4) {
+                float32x4_t v0 = vld1q_f32(&a[j0 + 0]);
+                float32x4_t v1 = vld1q_f32(&a[j0 + 8]);
+                float32x4_t v2 = vld1q_f32(&a[j0 + 16]);
+                float32x4_t v3 = vld1q_f32(&a[j0 + 24]);
+                Radix4_NEON(&cftmdl_wkr[0][4 * b], &cftmdl_wki[0][4 * b], 16,
+                            &v0, &v1, &v2, &v3);
+                vst1q_f32(&a[j0 + 0], v0);
+                vst1q_f32(&a[j0 + 8], v1);
+                vst1q_f32(&a[j0 + 16], v2);
+                vst1q_f32(&a[j0 + 24], v3);
+            }
+        }
+    }
+
+    // j1 = 1..28 を4つずつ処理し、残りの3つはスカラー版と同じ式で処理する。
+    inline void rftfsub_128_NEON(float* a) const {
+        const float* c = rdft_w + 32;
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        int j1, j2;
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const float32x4_t wkr = Reverse_NEON(vsubq_f32(half, vld1q_f32(&c[29 - j1])));
+            const float32x4_t wki = vld1q_f32(&c[j1]);
+            float32x4x2_t aj = vld2q_f32(&a[j2]);
+            float32x4x2_t ak = vld2q_f32(&a[122 - j2]);
+            ak.val[0] = Reverse_NEON(ak.val[0]);
+            ak.val[1] = Reverse_NEON(ak.val[1]);
+            const float32x4_t xr = vsubq_f32(aj.val[0], ak.val[0]);
+            const float32x4_t xi = vaddq_f32(aj.val[1], ak.val[1]);
+            const float32x4_t yr = vsubq_f32(vmulq_f32(wkr, xr), vmulq_f32(wki, xi));
+            const float32x4_t yi = vaddq_f32(vmulq_f32(wkr, xi), vmulq_f32(wki, xr));
+            aj.val[0] = vsubq_f32(aj.val[0], yr);
+            aj.val[1] = vsubq_f32(aj.val[1], yi);
+            ak.val[0] = Reverse_NEON(vaddq_f32(ak.val[0], yr));
+            ak.val[1] = Reverse_NEON(vsubq_f32(ak.val[1], yi));
+            vst2q_f32(&a[j2], aj);
+            vst2q_f32(&a[122 - j2], ak);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr - wki * xi;
+            const float yi = wkr * xi + wki * xr;
+            a[j2 + 0] -= yr;
+            a[j2 + 1] -= yi;
+            a[k2 + 0] += yr;
+            a[k2 + 1] -= yi;
+        }
+    }
+
+    inline void rftbsub_128_NEON(float* a) const {
+        const float* c = rdft_w + 32;
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        int j1, j2;
+        a[1] = -a[1];
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const float32x4_t wkr = Reverse_NEON(vsubq_f32(half, vld1q_f32(&c[29 - j1])));
+            const float32x4_t wki = vld1q_f32(&c[j1]);
+            float32x4x2_t aj = vld2q_f32(&a[j2]);
+            float32x4x2_t ak = vld2q_f32(&a[122 - j2]);
+            ak.val[0] = Reverse_NEON(ak.val[0]);
+            ak.val[1] = Reverse_NEON(ak.val[1]);
+            const float32x4_t xr = vsubq_f32(aj.val[0], ak.val[0]);
+            const float32x4_t xi = vaddq_f32(aj.val[1], ak.val[1]);
+            const float32x4_t yr = vaddq_f32(vmulq_f32(wkr, xr), vmulq_f32(wki, xi));
+            const float32x4_t yi = vsubq_f32(vmulq_f32(wkr, xi), vmulq_f32(wki, xr));
+            aj.val[0] = vsubq_f32(aj.val[0], yr);
+            aj.val[1] = vsubq_f32(yi, aj.val[1]);
+            ak.val[0] = Reverse_NEON(vaddq_f32(yr, ak.val[0]));
+            ak.val[1] = Reverse_NEON(vsubq_f32(yi, ak.val[1]));
+            vst2q_f32(&a[j2], aj);
+            vst2q_f32(&a[122 - j2], ak);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr + wki * xi;
+            const float yi = wkr * xi - wki * xr;
+            a[j2 + 0] = a[j2 + 0] - yr;
+            a[j2 + 1] = yi - a[j2 + 1];
+            a[k2 + 0] = yr + a[k2 + 0];
+            a[k2 + 1] = yi - a[k2 + 1];
+        }
+        a[65] = -a[65];
+    }
+#elif defined(__wasm_simd128__)
+    // WASM SIMD版（-msimd128）。各ベクトルは [re, im, re, im] の2複素数を保持する。
+    // 基本命令セットにFMAはないので、演算は SSE2版と同じ乗算と加減算の組で行う。
+    static inline v128_t CMul_WASM(v128_t wkr, v128_t wki, v128_t x) {
+        const v128_t xs = wasm_i32x4_shuffle(x, x, 1, 0, 3, 2);
+        return wasm_f32x4_add(wasm_f32x4_mul(wkr, x), wasm_f32x4_mul(wki, xs));
+    }
+
+    static inline v128_t Reverse_WASM(v128_t v) {
+        return wasm_i32x4_shuffle(v, v, 3, 2, 1, 0);
+    }
+
+    // cft1st/cftmdl 共通の基数4バタフライ。wkr/wki は wk1 の係数位置、stride で wk2, wk3 へ進む。
+    static inline void Radix4_WASM(const float* wkr, const float* wki, int stride,
+                                   v128_t* v0, v128_t* v1, v128_t* v2, v128_t* v3) {
+        const v128_t sign = wasm_f32x4_make(-1.f, 1.f, -1.f, 1.f);
+        const v128_t x0 = wasm_f32x4_add(*v0, *v1);
+        const v128_t x1 = wasm_f32x4_sub(*v0, *v1);
+        const v128_t x2 = wasm_f32x4_add(*v2, *v3);
+        const v128_t x3 = wasm_f32x4_sub(*v2, *v3);
+        // [-x3i, x3r]
+        const v128_t x3w = wasm_f32x4_mul(sign, wasm_i32x4_shuffle(x3, x3, 1, 0, 3, 2));
+        *v0 = wasm_f32x4_add(x0, x2);
+        *v1 = CMul_WASM(wasm_v128_load(wkr), wasm_v128_load(wki), wasm_f32x4_add(x1, x3w));
+        *v2 = CMul_WASM(wasm_v128_load(wkr + stride), wasm_v128_load(wki + stride),
+                        wasm_f32x4_sub(x0, x2));
+        *v3 = CMul_WASM(wasm_v128_load(wkr + 2 * stride), wasm_v128_load(wki + 2 * stride),
+                        wasm_f32x4_sub(x1, x3w));
+    }
+
+    inline void cft1st_128_WASM(float* a) const {
+        for (int j = 0, k = 0; j < 128; j += 16, k += 4) {
+            const v128_t a00 = wasm_v128_load(&a[j + 0]);
+            const v128_t a04 = wasm_v128_load(&a[j + 4]);
+            const v128_t a08 = wasm_v128_load(&a[j + 8]);
+            const v128_t a12 = wasm_v128_load(&a[j + 12]);
+            v128_t v0 = wasm_i32x4_shuffle(a00, a08, 0, 1, 4, 5);
+            v128_t v1 = wasm_i32x4_shuffle(a00, a08, 2, 3, 6, 7);
+            v128_t v2 = wasm_i32x4_shuffle(a04, a12, 0, 1, 4, 5);
+            v128_t v3 = wasm_i32x4_shuffle(a04, a12, 2, 3, 6, 7);
+            Radix4_WASM(&cft1st_wkr[0][k], &cft1st_wki[0][k], 32, &v0, &v1, &v2, &v3);
+            wasm_v128_store(&a[j + 0], wasm_i32x4_shuffle(v0, v1, 0, 1, 4, 5));
+            wasm_v128_store(&a[j + 4], wasm_i32x4_shuffle(v2, v3, 0, 1, 4, 5));
+            wasm_v128_store(&a[j + 8], wasm_i32x4_shuffle(v0, v1, 2, 3, 6, 7));
+            wasm_v128_store(&a[j + 12], wasm_i32x4_shuffle(v2, v3, 2, 3, 6, 7));
+        }
+    }
+
+    inline void cftmdl_128_WASM(float* a) const {
+        for (int b = 0; b < 4; ++b) {
+            for (int j0 = 32 * b; j0 < 32 * b + 8; j0 += 4) {
+                v128_t v0 = wasm_v128_load(&a[j0 + 0]);
+                v128_t v1 = wasm_v128_load(&a[j0 + 8]);
+                v128_t v2 = wasm_v128_load(&a[j0 + 16]);
+                v128_t v3 = wasm_v128_load(&a[j0 + 24]);
+                Radix4_WASM(&cftmdl_wkr[0][4 * b], &cftmdl_wki[0][4 * b], 16,
+                            &v0, &v1, &v2, &v3);
+                wasm_v128_store(&a[j0 + 0], v0);
+                wasm_v128_store(&a[j0 + 8], v1);
+                wasm_v128_store(&a[j0 + 16], v2);
+                wasm_v128_store(&a[j0 + 24], v3);
+            }
+        }
+    }
+
+    // j2側の4複素数を実部/虚部へ分け、k2側(逆順に並ぶ)の4複素数も同じ順序に揃える。
+    static inline void LoadPairs_WASM(const float* a, int j2,
+                                      v128_t* ajr, v128_t* aji,
+                                      v128_t* akr, v128_t* aki) {
+        const v128_t aj0 = wasm_v128_load(&a[j2 + 0]);
+        const v128_t aj4 = wasm_v128_load(&a[j2 + 4]);
+        const v128_t ak0 = wasm_v128_load(&a[122 - j2]);
+        const v128_t ak4 = wasm_v128_load(&a[126 - j2]);
+        *ajr = wasm_i32x4_shuffle(aj0, aj4, 0, 2, 4, 6);
+        *aji = wasm_i32x4_shuffle(aj0, aj4, 1, 3, 5, 7);
+        *akr = wasm_i32x4_shuffle(ak4, ak0, 2, 0, 6, 4);
+        *aki = wasm_i32x4_shuffle(ak4, ak0, 3, 1, 7, 5);
+    }
+
+    static inline void StorePairs_WASM(float* a, int j2,
+                                       v128_t ajr, v128_t aji,
+                                       v128_t akr, v128_t aki) {
+        wasm_v128_store(&a[j2 + 0], wasm_i32x4_shuffle(ajr, aji, 0, 4, 1, 5));
+        wasm_v128_store(&a[j2 + 4], wasm_i32x4_shuffle(ajr, aji, 2, 6, 3, 7));
+        wasm_v128_store(&a[122 - j2], wasm_i32x4_shuffle(akr, aki, 3, 7, 2, 6));
+        wasm_v128_store(&a[126 - j2], wasm_i32x4_shuffle(akr, aki, 1, 5, 0, 4));
+    }
+
+    // j1 = 1..28 を4つずつ処理し、残りの3つはスカラー版と同じ式で処理する。
+    inline void rftfsub_128_WASM(float* a) const {
+        const float* c = rdft_w + 32;
+        const v128_t half = wasm_f32x4_splat(0.5f);
+        int j1, j2;
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const v128_t wkr = Reverse_WASM(wasm_f32x4_sub(half, wasm_v128_load(&c[29 - j1])));
+            const v128_t wki = wasm_v128_load(&c[j1]);
+            v128_t ajr, aji, akr, aki;
+            LoadPairs_WASM(a, j2, &ajr, &aji, &akr, &aki);
+            const v128_t xr = wasm_f32x4_sub(ajr, akr);
+            const v128_t xi = wasm_f32x4_add(aji, aki);
+            const v128_t yr = wasm_f32x4_sub(wasm_f32x4_mul(wkr, xr), wasm_f32x4_mul(wki, xi));
+            const v128_t yi = wasm_f32x4_add(wasm_f32x4_mul(wkr, xi), wasm_f32x4_mul(wki, xr));
+            ajr = wasm_f32x4_sub(ajr, yr);
+            aji = wasm_f32x4_sub(aji, yi);
+            akr = wasm_f32x4_add(akr, yr);
+            aki = wasm_f32x4_sub(aki, yi);
+            StorePairs_WASM(a, j2, ajr, aji, akr, aki);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr - wki * xi;
+            const float yi = wkr * xi + wki * xr;
+            a[j2 + 0] -= yr;
+            a[j2 + 1] -= yi;
+            a[k2 + 0] += yr;
+            a[k2 + 1] -= yi;
+        }
+    }
+
+    inline void rftbsub_128_WASM(float* a) const {
+        const float* c = rdft_w + 32;
+        const v128_t half = wasm_f32x4_splat(0.5f);
+        int j1, j2;
+        a[1] = -a[1];
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const v128_t wkr = Reverse_WASM(wasm_f32x4_sub(half, wasm_v128_load(&c[29 - j1])));
+            const v128_t wki = wasm_v128_load(&c[j1]);
+            v128_t ajr, aji, akr, aki;
+            LoadPairs_WASM(a, j2, &ajr, &aji, &akr, &aki);
+            const v128_t xr = wasm_f32x4_sub(ajr, akr);
+            const v128_t xi = wasm_f32x4_add(aji, aki);
+            const v128_t yr = wasm_f32x4_add(wasm_f32x4_mul(wkr, xr), wasm_f32x4_mul(wki, xi));
+            const v128_t yi = wasm_f32x4_sub(wasm_f32x4_mul(wkr, xi), wasm_f32x4_mul(wki, xr));
+            ajr = wasm_f32x4_sub(ajr, yr);
+            aji = wasm_f32x4_sub(yi, aji);
+            akr = wasm_f32x4_add(yr, akr);
+            aki = wasm_f32x4_sub(yi, aki);
+            StorePairs_WASM(a, j2, ajr, aji, akr, aki);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr + wki * xi;
+            const float yi = wkr * xi - wki * xr;
+            a[j2 + 0] = a[j2 + 0] - yr;
+            a[j2 + 1] = yi - a[j2 + 1];
+            a[k2 + 0] = yr + a[k2 + 0];
+            a[k2 + 1] = yi - a[k2 + 1];
+        }
+        a[65] = -a[65];
+    }
+#elif defined(__SSE2__)
+    // SSE2版。各ベクトルは [re, im, re, im] の2複素数を保持する。
+    static inline __m128 CMul_SSE2(__m128 wkr, __m128 wki, __m128 x) {
+        const __m128 xs = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+        return _mm_add_ps(_mm_mul_ps(wkr, x), _mm_mul_ps(wki, xs));
+    }
+
+    static inline __m128 Reverse_SSE2(__m128 v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+
+    // cft1st/cftmdl 共通の基数4バタフライ。wkr/wki は wk1 の係数位置、stride で wk2, wk3 へ進む。
+    static inline void Radix4_SSE2(const float* wkr, const float* wki, int stride,
+                                   __m128* v0, __m128* v1, __m128* v2, __m128* v3) {
+        const __m128 sign = _mm_set_ps(1.f, -1.f, 1.f, -1.f);
+        const __m128 x0 = _mm_add_ps(*v0, *v1);
+        const __m128 x1 = _mm_sub_ps(*v0, *v1);
+        const __m128 x2 = _mm_add_ps(*v2, *v3);
+        const __m128 x3 = _mm_sub_ps(*v2, *v3);
+        // [-x3i, x3r]
+        const __m128 x3w =
+            _mm_mul_ps(sign, _mm_shuffle_ps(x3, x3, _MM_SHUFFLE(2, 3, 0, 1)));
+        *v0 = _mm_add_ps(x0, x2);
+        *v1 = CMul_SSE2(_mm_load_ps(wkr), _mm_load_ps(wki), _mm_add_ps(x1, x3w));
+        *v2 = CMul_SSE2(_mm_load_ps(wkr + stride), _mm_load_ps(wki + stride),
+                        _mm_sub_ps(x0, x2));
+        *v3 = CMul_SSE2(_mm_load_ps(wkr + 2 * stride), _mm_load_ps(wki + 2 * stride),
+                        _mm_sub_ps(x1, x3w));
+    }
+
+    inline void cft1st_128_SSE2(float* a) const {
+        for (int j = 0, k = 0; j < 128; j += 16, k += 4) {
+            const __m128 a00 = _mm_loadu_ps(&a[j + 0]);
+            const __m128 a04 = _mm_loadu_ps(&a[j + 4]);
+            const __m128 a08 = _mm_loadu_ps(&a[j + 8]);
+            const __m128 a12 = _mm_loadu_ps(&a[j + 12]);
+            __m128 v0 = _mm_shuffle_ps(a00, a08, _MM_SHUFFLE(1, 0, 1, 0));
+            __m128 v1 = _mm_shuffle_ps(a00, a08, _MM_SHUFFLE(3, 2, 3, 2));
+            __m128 v2 = _mm_shuffle_ps(a04, a12, _MM_SHUFFLE(1, 0, 1, 0));
+            __m128 v3 = _mm_shuffle_ps(a04, a12, _MM_SHUFFLE(3, 2, 3, 2));
+            Radix4_SSE2(&cft1st_wkr[0][k], &cft1st_wki[0][k], 32, &v0, &v1, &v2, &v3);
+            _mm_storeu_ps(&a[j + 0], _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 1, 0)));
+            _mm_storeu_ps(&a[j + 4], _mm_shuffle_ps(v2, v3, _MM_SHUFFLE(1, 0, 1, 0)));
+            _mm_storeu_ps(&a[j + 8], _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 2, 3, 2)));
+            _mm_storeu_ps(&a[j + 12], _mm_shuffle_ps(v2, v3, _MM_SHUFFLE(3, 2, 3, 2)));
+        }
+    }
+
+    inline void cftmdl_128_SSE2(float* a) const {
+        for (int b = 0; b < 4; ++b) {
+            for (int j0 = 32 * b; j0 < 32 * b + 8; j0 += 4) {
+                __m128 v0 = _mm_loadu_ps(&a[j0 + 0]);
+                __m128 v1 = _mm_loadu_ps(&a[j0 + 8]);
+                __m128 v2 = _mm_loadu_ps(&a[j0 + 16]);
+                __m128 v3 = _mm_loadu_ps(&a[j0 + 24]);
+                Radix4_SSE2(&cftmdl_wkr[0][4 * b], &cftmdl_wki[0][4 * b], 16,
+                            &v0, &v1, &v2, &v3);
+                _mm_storeu_ps(&a[j0 + 0], v0);
+                _mm_storeu_ps(&a[j0 + 8], v1);
+                _mm_storeu_ps(&a[j0 + 16], v2);
+                _mm_storeu_ps(&a[j0 + 24], v3);
+            }
+        }
+    }
+
+    // j2側の4複素数を実部/虚部へ分け、k2側(逆順に並ぶ)の4複素数も同じ順序に揃える。
+    static inline void LoadPairs_SSE2(const float* a, int j2,
+                                      __m128* ajr, __m128* aji,
+                                      __m128* akr, __m128* aki) {
+        const __m128 aj0 = _mm_loadu_ps(&a[j2 + 0]);
+        const __m128 aj4 = _mm_loadu_ps(&a[j2 + 4]);
+        const __m128 ak0 = _mm_loadu_ps(&a[122 - j2]);
+        const __m128 ak4 = _mm_loadu_ps(&a[126 - j2]);
+        *ajr = _mm_shuffle_ps(aj0, aj4, _MM_SHUFFLE(2, 0, 2, 0));
+        *aji = _mm_shuffle_ps(aj0, aj4, _MM_SHUFFLE(3, 1, 3, 1));
+        *akr = _mm_shuffle_ps(ak4, ak0, _MM_SHUFFLE(0, 2, 0, 2));
+        *aki = _mm_shuffle_ps(ak4, ak0, _MM_SHUFFLE(1, 3, 1, 3));
+    }
+
+    static inline void StorePairs_SSE2(float* a, int j2,
+                                       __m128 ajr, __m128 aji,
+                                       __m128 akr, __m128 aki) {
+        _mm_storeu_ps(&a[j2 + 0], _mm_unpacklo_ps(ajr, aji));
+        _mm_storeu_ps(&a[j2 + 4], _mm_unpackhi_ps(ajr, aji));
+        const __m128 k_lo = _mm_unpacklo_ps(akr, aki);
+        const __m128 k_hi = _mm_unpackhi_ps(akr, aki);
+        _mm_storeu_ps(&a[122 - j2], _mm_shuffle_ps(k_hi, k_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_ps(&a[126 - j2], _mm_shuffle_ps(k_lo, k_lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    // j1 = 1..28 を4つずつ処理し、残りの3つはスカラー版と同じ式で処理する。
+    inline void rftfsub_128_SSE2(float* a) const {
+        const float* c = rdft_w + 32;
+        const __m128 half = _mm_set1_ps(0.5f);
+        int j1, j2;
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const __m128 wkr = Reverse_SSE2(_mm_sub_ps(half, _mm_loadu_ps(&c[29 - j1])));
+            const __m128 wki = _mm_loadu_ps(&c[j1]);
+            __m128 ajr, aji, akr, aki;
+            LoadPairs_SSE2(a, j2, &ajr, &aji, &akr, &aki);
+            const __m128 xr = _mm_sub_ps(ajr, akr);
+            const __m128 xi = _mm_add_ps(aji, aki);
+            const __m128 yr = _mm_sub_ps(_mm_mul_ps(wkr, xr), _mm_mul_ps(wki, xi));
+            const __m128 yi = _mm_add_ps(_mm_mul_ps(wkr, xi), _mm_mul_ps(wki, xr));
+            ajr = _mm_sub_ps(ajr, yr);
+            aji = _mm_sub_ps(aji, yi);
+            akr = _mm_add_ps(akr, yr);
+            aki = _mm_sub_ps(aki, yi);
+            StorePairs_SSE2(a, j2, ajr, aji, akr, aki);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr - wki * xi;
+            const float yi = wkr * xi + wki * xr;
+            a[j2 + 0] -= yr;
+            a[j2 + 1] -= yi;
+            a[k2 + 0] += yr;
+            a[k2 + 1] -= yi;
+        }
+    }
+
+    inline void rftbsub_128_SSE2(float* a) const {
+        const float* c = rdft_w + 32;
+        const __m128 half = _mm_set1_ps(0.5f);
+        int j1, j2;
+        a[1] = -a[1];
+        for (j1 = 1, j2 = 2; j2 + 7 < 64; j1 += 4, j2 += 8) {
+            const __m128 wkr = Reverse_SSE2(_mm_sub_ps(half, _mm_loadu_ps(&c[29 - j1])));
+            const __m128 wki = _mm_loadu_ps(&c[j1]);
+            __m128 ajr, aji, akr, aki;
+            LoadPairs_SSE2(a, j2, &ajr, &aji, &akr, &aki);
+            const __m128 xr = _mm_sub_ps(ajr, akr);
+            const __m128 xi = _mm_add_ps(aji, aki);
+            const __m128 yr = _mm_add_ps(_mm_mul_ps(wkr, xr), _mm_mul_ps(wki, xi));
+            const __m128 yi = _mm_sub_ps(_mm_mul_ps(wkr, xi), _mm_mul_ps(wki, xr));
+            ajr = _mm_sub_ps(ajr, yr);
+            aji = _mm_sub_ps(yi, aji);
+            akr = _mm_add_ps(yr, akr);
+            aki = _mm_sub_ps(yi, aki);
+            StorePairs_SSE2(a, j2, ajr, aji, akr, aki);
+        }
+        for (; j2 < 64; j1 += 1, j2 += 2) {
+            const int k2 = 128 - j2;
+            const float wkr = 0.5f - c[32 - j1];
+            const float wki = c[j1];
+            const float xr = a[j2 + 0] - a[k2 + 0];
+            const float xi = a[j2 + 1] + a[k2 + 1];
+            const float yr = wkr * xr + wki * xi;
+            const float yi = wkr * xi - wki * xr;
+            a[j2 + 0] = a[j2 + 0] - yr;
+            a[j2 + 1] = yi - a[j2 + 1];
+            a[k2 + 0] = yr + a[k2 + 0];
+            a[k2 + 1] = yi - a[k2 + 1];
+        }
+        a[65] = -a[65];
+    }
+#endif
+
 
     void Fft(float* a) const {
         float xi;
@@ -328,18 +841,51 @@ struct OouraFft {
         cftbsub_128(a);
     }
 
+    // 実装はコンパイル時に選ぶ。NEON/WASM SIMD/SSE2 が使えない環境ではスカラー版（参照実装）を使う。
     void cft1st_128(float* a) const {
+#if defined(__ARM_NEON)
+        cft1st_128_NEON(a);
+#elif defined(__wasm_simd128__)
+        cft1st_128_WASM(a);
+#elif defined(__SSE2__)
+        cft1st_128_SSE2(a);
+#else
         cft1st_128_C(a);
+#endif
     }
     void cftmdl_128(float* a) const {
+#if defined(__ARM_NEON)
+        cftmdl_128_NEON(a);
+#elif defined(__wasm_simd128__)
+        cftmdl_128_WASM(a);
+#elif defined(__SSE2__)
+        cftmdl_128_SSE2(a);
+#else
         cftmdl_128_C(a);
+#endif
     }
     void rftfsub_128(float* a) const {
+#if defined(__ARM_NEON)
+        rftfsub_128_NEON(a);
+#elif defined(__wasm_simd128__)
+        rftfsub_128_WASM(a);
+#elif defined(__SSE2__)
+        rftfsub_128_SSE2(a);
+#else
         rftfsub_128_C(a);
+#endif
     }
 
     void rftbsub_128(float* a) const {
+#if defined(__ARM_NEON)
+        rftbsub_128_NEON(a);
+#elif defined(__wasm_simd128__)
+        rftbsub_128_WASM(a);
+#elif defined(__SSE2__)
+        rftbsub_128_SSE2(a);
+#else
         rftbsub_128_C(a);
+#endif
     }
 
     void cftbsub_128(float* a) const {
@@ -488,12 +1034,24 @@ inline void Fft(std::array<float, kFftLength>* x, FftData* X) {
   X->CopyFromPackedArray(*x);
 }
 
+// FFTを計算する（出力先がAlignedFftDataの版）。
+inline void Fft(std::array<float, kFftLength>* x, AlignedFftData* X) {
+  kOouraFft.Fft(x->data());
+  X->CopyFromPackedArray(*x);
+}
+
 // 逆FFTを計算する。
 inline void Ifft(const FftData& X, std::array<float, kFftLength>* x) {
   X.CopyToPackedArray(x);
   kOouraFft.InverseFft(x->data());
 }
 
+// 逆FFTを計算する（入力がAlignedFftDataの版）。
+inline void Ifft(const AlignedFftData& X, std::array<float, kFftLength>* x) {
+  X.CopyToPackedArray(x);
+  kOouraFft.InverseFft(x->data());
+}
+
 // 固定ハニング窓を適用し、後半にゼロを詰めてからFFTを計算する。
 inline void ZeroPaddedFft(std::span<const float> x, FftData* X) {
   std::array<float, kFftLength> fft;
@@ -507,17 +1065,32 @@ inline void ZeroPaddedFft(std::span<const float> x, FftData* X) {
   Fft(&fft, X);
 }
 
+// 過去ブロックx_oldと現在ブロックxを連結し、固定sqrt-Hanning窓を掛けてFFT入力を作る。
+inline void SqrtHanningWindow(std::span<const float> x,
+                              std::span<const float> x_old,
+                              std::array<float, kFftLength>* fft) {
+  std::transform(x_old.begin(), x_old.end(), std::begin(kSqrtHanning128),
+                 fft->begin(), std::multiplies<float>());
+  std::transform(x.begin(), x.end(),
+                 std::begin(kSqrtHanning128) + x_old.size(),
+                 fft->begin() + x_old.size(), std::multiplies<float>());
+}
+
 // 過去ブロックx_oldと現在ブロックxを連結し、固定sqrt-Hanning窓でパディングFFTを行う。
 // 呼び出し側では処理後にxをx_oldへコピーして解析・合成バンクを継続する想定。
 inline void PaddedFft(std::span<const float> x,
                      std::span<const float> x_old,
                      FftData* X) {
   std::array<float, kFftLength> fft;
-  // 固定sqrt-Hanning窓を適用
-  std::transform(x_old.begin(), x_old.end(), std::begin(kSqrtHanning128),
-                 fft.begin(), std::multiplies<float>());
-  std::transform(x.begin(), x.end(),
-                 std::begin(kSqrtHanning128) + x_old.size(),
-                 fft.begin() + x_old.size(), std::multiplies<float>());
+  SqrtHanningWindow(x, x_old, &fft);
+  Fft(&fft, X);
+}
+
+// パディングFFTの出力先がAlignedFftDataの版（レンダーFFTバッファ用）。
+inline void PaddedFft(std::span<const float> x,
+                     std::span<const float> x_old,
+                     AlignedFftData* X) {
+  std::array<float, kFftLength> fft;
+  SqrtHanningWindow(x, x_old, &fft);
   Fft(&fft, X);
 }
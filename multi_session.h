@@ -0,0 +1,70 @@
+// 1通話ぶんのエコーキャンセラ（レンダーバッファ・遅延推定器・エコー除去器の組）。
+struct EchoCancellerSession {
+  RenderDelayBuffer render_buffer_; // レンダー信号の遅延バッファ
+  EchoPathDelayEstimator delay_estimator_; // エコー経路の遅延推定器
+  EchoRemover echo_remover_; // エコー除去本体
+  int estimated_delay_blocks_ = -1; // 推定遅延(ブロック単位、未検出なら-1)
+
+  explicit EchoCancellerSession(const DelaySearchConfig& config)
+      : render_buffer_(config), delay_estimator_(config), echo_remover_() {}
+
+  // レンダー1ブロックを挿入し、キャプチャ1ブロックからエコーを除去する。
+  void ProcessBlock(const Block& render, Block* capture) {
+    render_buffer_.Insert(render);
+    ProcessCaptureBlock(&render_buffer_, &delay_estimator_, &echo_remover_,
+                        &estimated_delay_blocks_, capture);
+  }
+};
+
+// 独立した複数の通話をまとめて処理するエンジン。
+// 各セッションの状態は互いに独立で、処理結果はセッションを単独で動かした場合とビット単位で一致する。
+// 適応フィルタ・FFT・抑圧ゲインの各カーネルは1セッション内の周波数ビン方向にSIMD化済み
+// （パディング込み72ビン = AVX2 9本 / NEON 18本）で、ベクトル幅は既に埋まっている。
+// セッション方向にレーンを並べ替えても演算順序が変わる FFT ではビット一致が保てず、
+// 要素ごとの積和でも転置の分だけ遅くなるため、セッションごとの状態はそのまま連続して処理する。
+struct MultiSessionEchoCanceller {
+  const DelaySearchConfig config_; // 全セッション共通の遅延探索範囲
+  std::deque<EchoCancellerSession> sessions_; // セッション本体（追加しても既存の参照は無効にならない）
+
+  explicit MultiSessionEchoCanceller(size_t num_sessions,
+                                     const DelaySearchConfig& config = {})
+      : config_(config) {
+    for (size_t i = 0; i < num_sessions; ++i) {
+      AddSession();
+    }
+  }
+
+  // セッションを1つ追加し、その番号を返す。
+  size_t AddSession() {
+    sessions_.emplace_back(config_);
+    return sessions_.size() - 1;
+  }
+
+  size_t NumSessions() const { return sessions_.size(); }
+
+  // 個別の設定（SetProcessingModes など）やメトリクス参照用。
+  EchoCancellerSession& Session(size_t session_id) { return sessions_[session_id]; }
+
+  // session_ids[i] のセッションに render[i] と capture[i] を1ブロックずつ与え、結果を out[i] に書く。
+  // 同じセッションが複数回現れた場合は並びの順に処理する。out は capture と同じ領域でもよい。
+  // render・capture・out の長さが session_ids と異なるか、存在しないセッション番号を含む場合は何もせず false を返す。
+  bool ProcessBlocks(std::span<const size_t> session_ids,
+                     std::span<const Block> render,
+                     std::span<const Block> capture,
+                     std::span<Block> out) {
+    if (render.size() != session_ids.size() || capture.size() != session_ids.size() ||
+        out.size() != session_ids.size()) {
+      return false;
+    }
+    for (const size_t id : session_ids) {
+      if (id >= sessions_.size()) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < session_ids.size(); ++i) {
+      out[i] = capture[i];
+      sessions_[session_ids[i]].ProcessBlock(render[i], &out[i]);
+    }
+    return true;
+  }
+};
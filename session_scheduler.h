@@ -0,0 +1,206 @@
+// 多数のセッションをワーカースレッドのプールで並列に処理するスケジューラ（サーバー向け）。
+//
+// セッション i はワーカー i % num_workers の担当になる。各ワーカーは担当セッションを巡回して、
+// 入力キューにブロックがあるセッションを1ブロックずつ処理する。担当分に仕事がなければ他のワーカーの
+// 担当セッションから1ブロックを肩代わりする（ワークスティーリング）。肩代わりの探索はワーカーごとに
+// 前回の続きの位置から始めるので、暇なワーカーがそろって全セッションの先頭から探すことはない。
+// 1セッションを同時に処理できるのは claimed_ を取ったワーカー1つだけなので、セッションの状態と
+// 入出力キューの消費者/生産者は常に1スレッドに限られ、処理結果は単独で動かした場合と一致する。
+// 1巡で各セッションから取り出すのは1ブロックだけなので、どのセッションも1巡の処理時間以内に順番が回る。
+//
+// 呼び出し側はセッションごとに1スレッドから PushBlock/PopBlock を呼ぶこと（SPSCキューのため）。
+// all.h と multi_session.h の後に読み込む。
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct SessionScheduler {
+  // レンダーとキャプチャの1ブロック組（入力キューの要素）。
+  struct BlockPair {
+    Block render;
+    Block capture;
+  };
+
+  // 1セッション分の状態と入出力キュー。
+  struct SessionSlot {
+    EchoCancellerSession session_; // エコーキャンセラ本体
+    SpscRing<BlockPair> input_; // 呼び出し側 → ワーカー
+    SpscRing<Block> output_; // ワーカー → 呼び出し側
+    std::atomic<bool> claimed_{false}; // ワーカーが処理中か
+    std::atomic<uint64_t> input_overruns_{0}; // 入力キューが満杯で捨てたブロック数
+
+    SessionSlot(const DelaySearchConfig& config, size_t queue_blocks)
+        : session_(config), input_(queue_blocks), output_(queue_blocks) {}
+  };
+
+  // ワーカーごとの負荷メトリクス（他スレッドから読めるよう atomic で持つ）。
+  struct WorkerMetrics {
+    std::atomic<uint64_t> blocks_processed_{0}; // 処理したブロック数（肩代わり分を含む）
+    std::atomic<uint64_t> blocks_stolen_{0}; // 他ワーカーの担当から肩代わりしたブロック数
+    std::atomic<uint64_t> busy_ns_{0}; // ブロック処理に費やした時間
+    std::atomic<uint64_t> max_queue_depth_{0}; // 処理時に見た入力キュー長の最大
+    std::atomic<uint64_t> output_stalls_{0}; // 出力キューが満杯で処理を見送った回数
+  };
+
+  const size_t num_workers_;
+  std::deque<SessionSlot> slots_; // セッション（構築後は増減しない）
+  std::deque<WorkerMetrics> metrics_; // ワーカーごとのメトリクス
+  // 待機中のワーカーを起こす仕組み。std::atomic::wait は macOS 11 未満で使えないため条件変数で待つ。
+  // 投入側は世代を進めるだけで、眠っているワーカーがいるときだけロックを取って起こす。
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<uint32_t> work_epoch_{0}; // ブロック投入のたびに進める
+  std::atomic<size_t> sleeping_workers_{0}; // wake_ で待っている（待とうとしている）ワーカー数
+  std::atomic<bool> stop_{false};
+  std::vector<std::thread> workers_;
+
+  // queue_blocks: セッションごとの入出力キューの長さ（ブロック数）。遅延の上限はこの長さで決まる。
+  SessionScheduler(size_t num_workers,
+                   size_t num_sessions,
+                   size_t queue_blocks = 8,
+                   const DelaySearchConfig& config = {})
+      : num_workers_(std::max<size_t>(num_workers, 1)) {
+    for (size_t i = 0; i < num_sessions; ++i) {
+      slots_.emplace_back(config, queue_blocks);
+    }
+    for (size_t w = 0; w < num_workers_; ++w) {
+      metrics_.emplace_back();
+    }
+    for (size_t w = 0; w < num_workers_; ++w) {
+      workers_.emplace_back([this, w] { WorkerLoop(w); });
+    }
+  }
+
+  ~SessionScheduler() {
+    stop_.store(true, std::memory_order_release);
+    Wake(/*all=*/true);
+    for (std::thread& t : workers_) {
+      t.join();
+    }
+  }
+
+  // セッションの設定（SetProcessingModes など）はワーカーが処理を始める前、最初の PushBlock より前に行うこと。
+  EchoCancellerSession& Session(size_t session_id) { return slots_[session_id].session_; }
+
+  // 1ブロックを投入する。入力キューが満杯なら捨てて false を返す（input_overruns_ に計上）。
+  bool PushBlock(size_t session_id, const Block& render, const Block& capture) {
+    SessionSlot& slot = slots_[session_id];
+    const BlockPair pair{render, capture};
+    if (slot.input_.Write(std::span<const BlockPair>(&pair, 1)) == 0) {
+      slot.input_overruns_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    Wake(/*all=*/false);
+    return true;
+  }
+
+  // 処理済みのブロックを1つ取り出す。まだなければ false を返す。
+  // 出力キューが満杯で処理を見送っていたセッションのため、空きができたらワーカーを起こす。
+  bool PopBlock(size_t session_id, Block* out) {
+    SessionSlot& slot = slots_[session_id];
+    if (slot.output_.Read(std::span<Block>(out, 1)) == 0) {
+      return false;
+    }
+    if (slot.input_.Size() > 0) {
+      Wake(/*all=*/false);
+    }
+    return true;
+  }
+
+  // 入力キューに溜まっているブロック数。
+  size_t QueueDepth(size_t session_id) const { return slots_[session_id].input_.Size(); }
+
+  // セッションを1つ取れたら1ブロック処理する。処理したら true を返す。
+  bool TryProcess(size_t session_id, size_t worker, bool stolen) {
+    SessionSlot& slot = slots_[session_id];
+    if (slot.input_.Size() == 0 || slot.claimed_.exchange(true, std::memory_order_acquire)) {
+      return false;
+    }
+    WorkerMetrics& m = metrics_[worker];
+    bool processed = false;
+    const size_t depth = slot.input_.Size();
+    if (depth > 0 && slot.output_.Free() == 0) {
+      m.output_stalls_.fetch_add(1, std::memory_order_relaxed);
+    } else if (depth > 0) {
+      const auto start = std::chrono::steady_clock::now();
+      BlockPair pair;
+      slot.input_.Read(std::span<BlockPair>(&pair, 1));
+      slot.session_.ProcessBlock(pair.render, &pair.capture);
+      slot.output_.Write(std::span<const Block>(&pair.capture, 1));
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      m.busy_ns_.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+          std::memory_order_relaxed);
+      m.blocks_processed_.fetch_add(1, std::memory_order_relaxed);
+      if (stolen) {
+        m.blocks_stolen_.fetch_add(1, std::memory_order_relaxed);
+      }
+      if (depth > m.max_queue_depth_.load(std::memory_order_relaxed)) {
+        m.max_queue_depth_.store(depth, std::memory_order_relaxed);
+      }
+      processed = true;
+    }
+    slot.claimed_.store(false, std::memory_order_release);
+    return processed;
+  }
+
+  // 担当セッションを1巡し、仕事がなければ他ワーカーの担当から1ブロックを肩代わりする。
+  // steal_cursor はワーカーごとの肩代わり探索の開始位置で、見つかったセッションの次へ進める。
+  // 何か処理したら true を返す。
+  bool RunPass(size_t worker, size_t* steal_cursor) {
+    bool processed = false;
+    for (size_t s = worker; s < slots_.size(); s += num_workers_) {
+      processed |= TryProcess(s, worker, /*stolen=*/false);
+    }
+    if (processed) {
+      return true;
+    }
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      const size_t s = (*steal_cursor + i) % slots_.size();
+      if (s % num_workers_ != worker && TryProcess(s, worker, /*stolen=*/true)) {
+        *steal_cursor = (s + 1) % slots_.size();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 世代を進め、眠っているワーカーがいれば起こす。
+  // 世代の更新と sleeping_workers_ の読み出しは seq_cst なので、WorkerLoop が眠る直前に
+  // 世代を確かめた場合とどちらかが必ず相手の更新を見る（起こし損ねない）。
+  void Wake(bool all) {
+    work_epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping_workers_.load(std::memory_order_seq_cst) == 0) {
+      return;
+    }
+    // 待つ側が世代を確かめてから wait に入るまでの間に通知しないよう、ロックを通ってから起こす。
+    { std::lock_guard<std::mutex> lock(wake_mutex_); }
+    if (all) {
+      wake_.notify_all();
+    } else {
+      wake_.notify_one();
+    }
+  }
+
+  void WorkerLoop(size_t worker) {
+    size_t steal_cursor = slots_.empty() ? 0 : worker * slots_.size() / num_workers_;
+    while (!stop_.load(std::memory_order_acquire)) {
+      if (RunPass(worker, &steal_cursor)) {
+        continue;
+      }
+      // 巡回前の世代を控えてからもう1巡し、その間に投入があれば待たずに戻る。
+      const uint32_t epoch = work_epoch_.load(std::memory_order_seq_cst);
+      if (RunPass(worker, &steal_cursor)) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      sleeping_workers_.fetch_add(1, std::memory_order_seq_cst);
+      wake_.wait(lock, [&] {
+        return work_epoch_.load(std::memory_order_seq_cst) != epoch ||
+               stop_.load(std::memory_order_acquire);
+      });
+      sleeping_workers_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+  }
+};
@@ -0,0 +1,62 @@
+// 単一生産者・単一消費者(SPSC)のロックフリー・リングバッファ。
+// 書き込み位置は生産者だけが、読み出し位置は消費者だけが進めるので、ロックなしで2スレッド間を受け渡せる。
+// 容量は2のべき乗に切り上げ、領域は構築時に確保したきり（読み書きでヒープ確保はしない）。
+// 書き込み・読み出し位置は別々のキャッシュラインに置き、両スレッドが同じラインを奪い合わないようにする。
+template <typename T>
+struct SpscRing {
+  inline static constexpr size_t kCacheLineSize = 64;
+
+  std::vector<T> buffer_; // 要素の格納領域
+  const size_t mask_; // 添字のマスク（容量-1）
+  alignas(kCacheLineSize) std::atomic<size_t> write_{0}; // 書き込んだ要素の累計（生産者が更新）
+  alignas(kCacheLineSize) std::atomic<size_t> read_{0}; // 読み出した要素の累計（消費者が更新）
+
+  explicit SpscRing(size_t capacity)
+      : buffer_(std::bit_ceil(std::max<size_t>(capacity, 1))),
+        mask_(buffer_.size() - 1) {}
+
+  size_t Capacity() const { return buffer_.size(); }
+
+  // 読み出せる要素数（どちらのスレッドから呼んでもよい）。
+  size_t Size() const {
+    return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+  }
+
+  // 書き込める要素数。
+  size_t Free() const { return Capacity() - Size(); }
+
+  // 生産者側: src を書ける分だけまとめて書き込み、書いた要素数を返す。
+  size_t Write(std::span<const T> src) {
+    const size_t w = write_.load(std::memory_order_relaxed);
+    const size_t r = read_.load(std::memory_order_acquire);
+    const size_t n = std::min(src.size(), Capacity() - (w - r));
+    const size_t first = std::min(n, Capacity() - (w & mask_));
+    std::copy_n(src.begin(), first, buffer_.begin() + (w & mask_));
+    std::copy_n(src.begin() + first, n - first, buffer_.begin());
+    write_.store(w + n, std::memory_order_release);
+    return n;
+  }
+
+  // 消費者側: dst を埋められる分だけまとめて読み出し、読んだ要素数を返す。
+  size_t Read(std::span<T> dst) {
+    const size_t n = Peek(dst);
+    Discard(n);
+    return n;
+  }
+
+  // 消費者側: 読み出し位置を進めずに先頭から dst へコピーする。
+  size_t Peek(std::span<T> dst) const {
+    const size_t r = read_.load(std::memory_order_relaxed);
+    const size_t w = write_.load(std::memory_order_acquire);
+    const size_t n = std::min(dst.size(), w - r);
+    const size_t first = std::min(n, Capacity() - (r & mask_));
+    std::copy_n(buffer_.begin() + (r & mask_), first, dst.begin());
+    std::copy_n(buffer_.begin(), n - first, dst.begin() + first);
+    return n;
+  }
+
+  // 消費者側: 先頭の n 要素を捨てる（n は Size() 以下であること）。
+  void Discard(size_t n) {
+    read_.store(read_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+};
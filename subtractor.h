@@ -4,6 +4,7 @@ struct SubtractorOutput {
   std::array<float, kBlockSize> e; // キャプチャ信号と推定エコーとの差分（残差信号）
   FftData E; // 残差信号eの周波数領域表現
   std::array<float, kFftLengthBy2Plus1> E2; // 残差信号Eのパワースペクトル
+  std::array<float, kFftLengthBy2Plus1> S2; // 線形フィルタ出力Sのパワースペクトル（線形エコー推定）
   float e2 = 0.f; // 残差信号の時間領域パワー（自乗和）
   float y2 = 0.f; // 入力キャプチャ信号の時間領域パワー（自乗和）
 
@@ -90,39 +91,290 @@ struct AecState {
   size_t blocks_since_reset_ = 0;
   ErleEstimator erle_estimator_;
 };
-// フィルタの周波数応答を計算して保持する。
-// num_partitions: パーティション数, H: フィルタ係数のFFT結果, H2: 出力先
-inline void ComputeFrequencyResponse(
-    size_t num_partitions,
-    const std::vector<FftData>& H,
-    std::vector<std::array<float, kFftLengthBy2Plus1>>* H2) {
-  for (std::array<float, kFftLengthBy2Plus1>& H2_ch : *H2) {
-    H2_ch.fill(0.f);
+// 1パーティション分の複素積和 S += X·H（スカラー版、参照実装）。
+inline void ApplyPartition_C(const AlignedFftData& X, const AlignedFftData& H,
+                             AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+    S->re[k] += X.re[k] * H.re[k] - X.im[k] * H.im[k];
+    S->im[k] += X.re[k] * H.im[k] + X.im[k] * H.re[k];
   }
-  for (size_t p = 0; p < num_partitions; ++p) {
-    for (size_t j = 0; j < kFftLengthBy2Plus1; ++j) {
-      float tmp = H[p].re[j] * H[p].re[j] + H[p].im[j] * H[p].im[j];
-      (*H2)[p][j] = std::max((*H2)[p][j], tmp);
-    }
+}
+
+// 1パーティション分の係数更新 H += conj(X)·G（スカラー版、参照実装）。
+inline void AdaptPartition_C(const AlignedFftData& X, const AlignedFftData& G,
+                             AlignedFftData* H) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+    H->re[k] += X.re[k] * G.re[k] + X.im[k] * G.im[k];
+    H->im[k] += X.re[k] * G.im[k] - X.im[k] * G.re[k];
+  }
+}
+
+// 融合版: X を1回読むだけで H_prev += conj(X)·G と S += X·H を同時に行う（スカラー版、参照実装）。
+// H_prev は1つ前のパーティション、H は X と同じパーティションの係数。
+inline void AdaptAndApplyPartition_C(const AlignedFftData& X, const AlignedFftData& G,
+                                     AlignedFftData* H_prev, const AlignedFftData& H,
+                                     AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+    H_prev->re[k] += X.re[k] * G.re[k] + X.im[k] * G.im[k];
+    H_prev->im[k] += X.re[k] * G.im[k] - X.im[k] * G.re[k];
+    S->re[k] += X.re[k] * H.re[k] - X.im[k] * H.im[k];
+    S->im[k] += X.re[k] * H.im[k] + X.im[k] * H.re[k];
+  }
+}
+
+#if defined(__ARM_NEON)
+// NEON版。パディングを含む72要素を4ビンずつFMAで処理する（パディング部は0のまま保たれる）。
+inline void ApplyPartition_NEON(const AlignedFftData& X, const AlignedFftData& H,
+                                AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const float32x4_t x_re = vld1q_f32(&X.re[k]);
+    const float32x4_t x_im = vld1q_f32(&X.im[k]);
+    const float32x4_t h_re = vld1q_f32(&H.re[k]);
+    const float32x4_t h_im = vld1q_f32(&H.im[k]);
+    float32x4_t s_re = vld1q_f32(&S->re[k]);
+    float32x4_t s_im = vld1q_f32(&S->im[k]);
+    s_re = vfmaq_f32(s_re, x_re, h_re);
+    s_re = vfmsq_f32(s_re, x_im, h_im);
+    s_im = vfmaq_f32(s_im, x_re, h_im);
+    s_im = vfmaq_f32(s_im, x_im, h_re);
+    vst1q_f32(&S->re[k], s_re);
+    vst1q_f32(&S->im[k], s_im);
   }
 }
 
+inline void AdaptPartition_NEON(const AlignedFftData& X, const AlignedFftData& G,
+                                AlignedFftData* H) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const float32x4_t x_re = vld1q_f32(&X.re[k]);
+    const float32x4_t x_im = vld1q_f32(&X.im[k]);
+    const float32x4_t g_re = vld1q_f32(&G.re[k]);
+    const float32x4_t g_im = vld1q_f32(&G.im[k]);
+    float32x4_t h_re = vld1q_f32(&H->re[k]);
+    float32x4_t h_im = vld1q_f32(&H->im[k]);
+    h_re = vfmaq_f32(h_re, x_re, g_re);
+    h_re = vfmaq_f32(h_re, x_im, g_im);
+    h_im = vfmaq_f32(h_im, x_re, g_im);
+    h_im = vfmsq_f32(h_im, x_im, g_re);
+    vst1q_f32(&H->re[k], h_re);
+    vst1q_f32(&H->im[k], h_im);
+  }
+}
+
+inline void AdaptAndApplyPartition_NEON(const AlignedFftData& X, const AlignedFftData& G,
+                                        AlignedFftData* H_prev, const AlignedFftData& H,
+                                        AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const float32x4_t x_re = vld1q_f32(&X.re[k]);
+    const float32x4_t x_im = vld1q_f32(&X.im[k]);
+    const float32x4_t g_re = vld1q_f32(&G.re[k]);
+    const float32x4_t g_im = vld1q_f32(&G.im[k]);
+    float32x4_t hp_re = vld1q_f32(&H_prev->re[k]);
+    float32x4_t hp_im = vld1q_f32(&H_prev->im[k]);
+    hp_re = vfmaq_f32(hp_re, x_re, g_re);
+    hp_re = vfmaq_f32(hp_re, x_im, g_im);
+    hp_im = vfmaq_f32(hp_im, x_re, g_im);
+    hp_im = vfmsq_f32(hp_im, x_im, g_re);
+    vst1q_f32(&H_prev->re[k], hp_re);
+    vst1q_f32(&H_prev->im[k], hp_im);
+    const float32x4_t h_re = vld1q_f32(&H.re[k]);
+    const float32x4_t h_im = vld1q_f32(&H.im[k]);
+    float32x4_t s_re = vld1q_f32(&S->re[k]);
+    float32x4_t s_im = vld1q_f32(&S->im[k]);
+    s_re = vfmaq_f32(s_re, x_re, h_re);
+    s_re = vfmsq_f32(s_re, x_im, h_im);
+    s_im = vfmaq_f32(s_im, x_re, h_im);
+    s_im = vfmaq_f32(s_im, x_im, h_re);
+    vst1q_f32(&S->re[k], s_re);
+    vst1q_f32(&S->im[k], s_im);
+  }
+}
+#elif defined(__wasm_simd128__)
+// WASM SIMD版（-msimd128）。パディングを含む72要素を4ビンずつ処理する。基本命令セットにFMAはないので乗算と加減算で行う。
+inline void ApplyPartition_WASM(const AlignedFftData& X, const AlignedFftData& H,
+                                AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const v128_t x_re = wasm_v128_load(&X.re[k]);
+    const v128_t x_im = wasm_v128_load(&X.im[k]);
+    const v128_t h_re = wasm_v128_load(&H.re[k]);
+    const v128_t h_im = wasm_v128_load(&H.im[k]);
+    v128_t s_re = wasm_v128_load(&S->re[k]);
+    v128_t s_im = wasm_v128_load(&S->im[k]);
+    s_re = wasm_f32x4_add(s_re, wasm_f32x4_mul(x_re, h_re));
+    s_re = wasm_f32x4_sub(s_re, wasm_f32x4_mul(x_im, h_im));
+    s_im = wasm_f32x4_add(s_im, wasm_f32x4_mul(x_re, h_im));
+    s_im = wasm_f32x4_add(s_im, wasm_f32x4_mul(x_im, h_re));
+    wasm_v128_store(&S->re[k], s_re);
+    wasm_v128_store(&S->im[k], s_im);
+  }
+}
+
+inline void AdaptPartition_WASM(const AlignedFftData& X, const AlignedFftData& G,
+                                AlignedFftData* H) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const v128_t x_re = wasm_v128_load(&X.re[k]);
+    const v128_t x_im = wasm_v128_load(&X.im[k]);
+    const v128_t g_re = wasm_v128_load(&G.re[k]);
+    const v128_t g_im = wasm_v128_load(&G.im[k]);
+    v128_t h_re = wasm_v128_load(&H->re[k]);
+    v128_t h_im = wasm_v128_load(&H->im[k]);
+    h_re = wasm_f32x4_add(h_re, wasm_f32x4_mul(x_re, g_re));
+    h_re = wasm_f32x4_add(h_re, wasm_f32x4_mul(x_im, g_im));
+    h_im = wasm_f32x4_add(h_im, wasm_f32x4_mul(x_re, g_im));
+    h_im = wasm_f32x4_sub(h_im, wasm_f32x4_mul(x_im, g_re));
+    wasm_v128_store(&H->re[k], h_re);
+    wasm_v128_store(&H->im[k], h_im);
+  }
+}
+
+inline void AdaptAndApplyPartition_WASM(const AlignedFftData& X, const AlignedFftData& G,
+                                        AlignedFftData* H_prev, const AlignedFftData& H,
+                                        AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 4) {
+    const v128_t x_re = wasm_v128_load(&X.re[k]);
+    const v128_t x_im = wasm_v128_load(&X.im[k]);
+    const v128_t g_re = wasm_v128_load(&G.re[k]);
+    const v128_t g_im = wasm_v128_load(&G.im[k]);
+    v128_t hp_re = wasm_v128_load(&H_prev->re[k]);
+    v128_t hp_im = wasm_v128_load(&H_prev->im[k]);
+    hp_re = wasm_f32x4_add(hp_re, wasm_f32x4_mul(x_re, g_re));
+    hp_re = wasm_f32x4_add(hp_re, wasm_f32x4_mul(x_im, g_im));
+    hp_im = wasm_f32x4_add(hp_im, wasm_f32x4_mul(x_re, g_im));
+    hp_im = wasm_f32x4_sub(hp_im, wasm_f32x4_mul(x_im, g_re));
+    wasm_v128_store(&H_prev->re[k], hp_re);
+    wasm_v128_store(&H_prev->im[k], hp_im);
+    const v128_t h_re = wasm_v128_load(&H.re[k]);
+    const v128_t h_im = wasm_v128_load(&H.im[k]);
+    v128_t s_re = wasm_v128_load(&S->re[k]);
+    v128_t s_im = wasm_v128_load(&S->im[k]);
+    s_re = wasm_f32x4_add(s_re, wasm_f32x4_mul(x_re, h_re));
+    s_re = wasm_f32x4_sub(s_re, wasm_f32x4_mul(x_im, h_im));
+    s_im = wasm_f32x4_add(s_im, wasm_f32x4_mul(x_re, h_im));
+    s_im = wasm_f32x4_add(s_im, wasm_f32x4_mul(x_im, h_re));
+    wasm_v128_store(&S->re[k], s_re);
+    wasm_v128_store(&S->im[k], s_im);
+  }
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+// AVX2/FMA版。パディングを含む72要素を8ビンずつ整列ロードで処理する。
+inline void ApplyPartition_AVX2(const AlignedFftData& X, const AlignedFftData& H,
+                                AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 8) {
+    const __m256 x_re = _mm256_load_ps(&X.re[k]);
+    const __m256 x_im = _mm256_load_ps(&X.im[k]);
+    const __m256 h_re = _mm256_load_ps(&H.re[k]);
+    const __m256 h_im = _mm256_load_ps(&H.im[k]);
+    __m256 s_re = _mm256_load_ps(&S->re[k]);
+    __m256 s_im = _mm256_load_ps(&S->im[k]);
+    s_re = _mm256_fmadd_ps(x_re, h_re, s_re);
+    s_re = _mm256_fnmadd_ps(x_im, h_im, s_re);
+    s_im = _mm256_fmadd_ps(x_re, h_im, s_im);
+    s_im = _mm256_fmadd_ps(x_im, h_re, s_im);
+    _mm256_store_ps(&S->re[k], s_re);
+    _mm256_store_ps(&S->im[k], s_im);
+  }
+}
+
+inline void AdaptPartition_AVX2(const AlignedFftData& X, const AlignedFftData& G,
+                                AlignedFftData* H) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 8) {
+    const __m256 x_re = _mm256_load_ps(&X.re[k]);
+    const __m256 x_im = _mm256_load_ps(&X.im[k]);
+    const __m256 g_re = _mm256_load_ps(&G.re[k]);
+    const __m256 g_im = _mm256_load_ps(&G.im[k]);
+    __m256 h_re = _mm256_load_ps(&H->re[k]);
+    __m256 h_im = _mm256_load_ps(&H->im[k]);
+    h_re = _mm256_fmadd_ps(x_re, g_re, h_re);
+    h_re = _mm256_fmadd_ps(x_im, g_im, h_re);
+    h_im = _mm256_fmadd_ps(x_re, g_im, h_im);
+    h_im = _mm256_fnmadd_ps(x_im, g_re, h_im);
+    _mm256_store_ps(&H->re[k], h_re);
+    _mm256_store_ps(&H->im[k], h_im);
+  }
+}
+
+inline void AdaptAndApplyPartition_AVX2(const AlignedFftData& X, const AlignedFftData& G,
+                                        AlignedFftData* H_prev, const AlignedFftData& H,
+                                        AlignedFftData* S) {
+  for (size_t k = 0; k < kFftLengthBy2Plus1Padded; k += 8) {
+    const __m256 x_re = _mm256_load_ps(&X.re[k]);
+    const __m256 x_im = _mm256_load_ps(&X.im[k]);
+    const __m256 g_re = _mm256_load_ps(&G.re[k]);
+    const __m256 g_im = _mm256_load_ps(&G.im[k]);
+    __m256 hp_re = _mm256_load_ps(&H_prev->re[k]);
+    __m256 hp_im = _mm256_load_ps(&H_prev->im[k]);
+    hp_re = _mm256_fmadd_ps(x_re, g_re, hp_re);
+    hp_re = _mm256_fmadd_ps(x_im, g_im, hp_re);
+    hp_im = _mm256_fmadd_ps(x_re, g_im, hp_im);
+    hp_im = _mm256_fnmadd_ps(x_im, g_re, hp_im);
+    _mm256_store_ps(&H_prev->re[k], hp_re);
+    _mm256_store_ps(&H_prev->im[k], hp_im);
+    const __m256 h_re = _mm256_load_ps(&H.re[k]);
+    const __m256 h_im = _mm256_load_ps(&H.im[k]);
+    __m256 s_re = _mm256_load_ps(&S->re[k]);
+    __m256 s_im = _mm256_load_ps(&S->im[k]);
+    s_re = _mm256_fmadd_ps(x_re, h_re, s_re);
+    s_re = _mm256_fnmadd_ps(x_im, h_im, s_re);
+    s_im = _mm256_fmadd_ps(x_re, h_im, s_im);
+    s_im = _mm256_fmadd_ps(x_im, h_re, s_im);
+    _mm256_store_ps(&S->re[k], s_re);
+    _mm256_store_ps(&S->im[k], s_im);
+  }
+}
+#endif
+
+// 実装はコンパイル時に選ぶ。x86-64 では -mavx2 -mfma 指定時のみAVX2版、WASM では -msimd128 指定時のみWASM SIMD版になり、
+// それ以外はスカラー版を使う。
+inline void ApplyPartition(const AlignedFftData& X, const AlignedFftData& H,
+                           AlignedFftData* S) {
+#if defined(__ARM_NEON)
+  ApplyPartition_NEON(X, H, S);
+#elif defined(__wasm_simd128__)
+  ApplyPartition_WASM(X, H, S);
+#elif defined(__AVX2__) && defined(__FMA__)
+  ApplyPartition_AVX2(X, H, S);
+#else
+  ApplyPartition_C(X, H, S);
+#endif
+}
+
+inline void AdaptPartition(const AlignedFftData& X, const AlignedFftData& G,
+                           AlignedFftData* H) {
+#if defined(__ARM_NEON)
+  AdaptPartition_NEON(X, G, H);
+#elif defined(__wasm_simd128__)
+  AdaptPartition_WASM(X, G, H);
+#elif defined(__AVX2__) && defined(__FMA__)
+  AdaptPartition_AVX2(X, G, H);
+#else
+  AdaptPartition_C(X, G, H);
+#endif
+}
+
+inline void AdaptAndApplyPartition(const AlignedFftData& X, const AlignedFftData& G,
+                                   AlignedFftData* H_prev, const AlignedFftData& H,
+                                   AlignedFftData* S) {
+#if defined(__ARM_NEON)
+  AdaptAndApplyPartition_NEON(X, G, H_prev, H, S);
+#elif defined(__wasm_simd128__)
+  AdaptAndApplyPartition_WASM(X, G, H_prev, H, S);
+#elif defined(__AVX2__) && defined(__FMA__)
+  AdaptAndApplyPartition_AVX2(X, G, H_prev, H, S);
+#else
+  AdaptAndApplyPartition_C(X, G, H_prev, H, S);
+#endif
+}
+
 // フィルタ係数の各パーティションを適応更新する。
-// render_buffer: レンダーFFTバッファ, G: 更新ゲイン, num_partitions: パーティション数, H: フィルタ係数格納先
+// render_buffer: レンダーFFTバッファ, position: パーティション0に対応する読み出し位置,
+// G: 更新ゲイン, num_partitions: パーティション数, H: フィルタ係数格納先
 inline void AdaptPartitions(const RenderBuffer& render_buffer,
-                            const FftData& G,
+                            size_t position,
+                            const AlignedFftData& G,
                             size_t num_partitions,
-                            std::vector<FftData>* H) {
-  std::span<const FftData> render_buffer_data = render_buffer.GetFftBuffer();
-  size_t index = render_buffer.Position();
+                            std::vector<AlignedFftData>* H) {
+  std::span<const AlignedFftData> X = render_buffer.GetFftPartitions(position, num_partitions);
   for (size_t p = 0; p < num_partitions; ++p) {
-    const FftData& X_p = render_buffer_data[index];
-    FftData& H_p = (*H)[p];
-    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
-      H_p.re[k] += X_p.re[k] * G.re[k] + X_p.im[k] * G.im[k];
-      H_p.im[k] += X_p.re[k] * G.im[k] - X_p.im[k] * G.re[k];
-    }
-    index = index < (render_buffer_data.size() - 1) ? index + 1 : 0;
+    AdaptPartition(X[p], G, &(*H)[p]);
   }
 }
 
@@ -130,45 +382,57 @@ inline void AdaptPartitions(const RenderBuffer& render_buffer,
 // render_buffer: レンダーFFTバッファ, num_partitions: パーティション数, H: フィルタ係数, S: 出力先
 inline void ApplyFilter(const RenderBuffer& render_buffer,
                         size_t num_partitions,
-                        const std::vector<FftData>& H,
-                        FftData* S) {
+                        const std::vector<AlignedFftData>& H,
+                        AlignedFftData* S) {
   S->re.fill(0.f);
   S->im.fill(0.f);
-  std::span<const FftData> render_buffer_data = render_buffer.GetFftBuffer();
-  size_t index = render_buffer.Position();
+  std::span<const AlignedFftData> X =
+      render_buffer.GetFftPartitions(render_buffer.Position(), num_partitions);
   for (size_t p = 0; p < num_partitions; ++p) {
-    const FftData& X_p = render_buffer_data[index];
-    const FftData& H_p = H[p];
-    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
-      S->re[k] += X_p.re[k] * H_p.re[k] - X_p.im[k] * H_p.im[k];
-      S->im[k] += X_p.re[k] * H_p.im[k] + X_p.im[k] * H_p.re[k];
-    }
-    index = index < (render_buffer_data.size() - 1) ? index + 1 : 0;
+    ApplyPartition(X[p], H[p], S);
   }
 }
 
-// 周波数応答を合計して Echo Return Loss を算出する。
-// H2: パーティション別のパワースペクトル, erl: 出力先
-inline void ComputeErl(
-    const std::vector<std::array<float, kFftLengthBy2Plus1>>& H2,
-    std::span<float> erl) {
-  std::fill(erl.begin(), erl.end(), 0.f);
-  for (const std::array<float, kFftLengthBy2Plus1>& H2_j : H2) {
-    std::transform(H2_j.begin(), H2_j.end(), erl.begin(), erl.begin(),
-                   std::plus<float>());
+// 前ブロックの係数更新と現ブロックのフィルタ出力を1回の走査で行う。
+// 読み出し位置が1ブロック進むと現ブロックの X_p は前ブロックの X_{p-1} に一致するので、
+// X_p を読んだついでに H_{p-1} += conj(X_p)·G と S += X_p·H_p を計算できる。
+// H_p は1つ前のステップで更新済みになるよう、ステップ p を p_end-1 から p_begin へ降順に処理する。
+// ステップ num_partitions は更新のみ、ステップ0は出力のみ行う。
+// render_buffer: レンダーFFTバッファ, G: 前ブロックの更新ゲイン, num_partitions: パーティション数,
+// p_begin/p_end: 処理するステップ範囲, H: フィルタ係数, S: 出力の積算先
+inline void AdaptAndApplyPartitions(const RenderBuffer& render_buffer,
+                                    const AlignedFftData& G,
+                                    size_t num_partitions,
+                                    size_t p_begin,
+                                    size_t p_end,
+                                    std::vector<AlignedFftData>* H,
+                                    AlignedFftData* S) {
+  std::span<const AlignedFftData> X =
+      render_buffer.GetFftPartitions(render_buffer.Position(), num_partitions + 1);
+  for (size_t p = p_end; p-- > p_begin;) {
+    if (p == num_partitions) {
+      AdaptPartition(X[p], G, &(*H)[p - 1]);
+    } else if (p == 0) {
+      ApplyPartition(X[p], (*H)[p], S);
+    } else {
+      AdaptAndApplyPartition(X[p], G, &(*H)[p - 1], (*H)[p], S);
+    }
   }
 }
 
- 
-
 // 周波数領域で動作する適応フィルタを提供する。
 struct AdaptiveFirFilter {
   const size_t size_partitions_; // ブロック単位のパーティション数
-  std::vector<FftData> H_; // 各パーティションの周波数領域係数
+  std::vector<AlignedFftData> H_; // 各パーティションの周波数領域係数
   size_t partition_to_constrain_ = 0; // 正規化対象のパーティションインデックス
+  AlignedFftData pending_gain_; // 次ブロックのFilterで反映する更新ゲイン
+  size_t pending_position_ = 0; // 保留中の更新を計算したときのレンダー読み出し位置
+  bool update_pending_ = false; // 係数更新（と正規化）を保留しているか
+  bool pending_gain_is_zero_ = false; // 保留中の更新ゲインが全ビン0か（係数更新を省略できる）
 
   AdaptiveFirFilter(size_t size_partitions)
-      : size_partitions_(size_partitions), H_(size_partitions) {
+      : size_partitions_(size_partitions),
+        H_(size_partitions) {
     for (size_t p = 0; p < H_.size(); ++p) {
       H_[p].Clear();
     }
@@ -178,10 +442,77 @@ struct AdaptiveFirFilter {
 
 
   // 既知のエコーパス変化が発生したときにフィルタ係数を初期化する。
+  // 保留中の更新は係数ごと捨てるが、正規化の巡回位置は更新した場合と揃えておく。
   void HandleEchoPathChange() {
     for (size_t p = 0; p < H_.size(); ++p) {
       H_[p].Clear();
     }
+    if (update_pending_) {
+      update_pending_ = false;
+      AdvancePartitionToConstrain();
+    }
+  }
+
+  // 保留中の係数更新と正規化があれば、フィルタ出力を作らずにここで反映する。
+  void FlushPendingAdaptation(const RenderBuffer& render_buffer) {
+    if (!update_pending_) {
+      return;
+    }
+    update_pending_ = false;
+    if (!pending_gain_is_zero_) {
+      AdaptPartitions(render_buffer, pending_position_, pending_gain_,
+                      size_partitions_, &H_);
+    }
+    Constrain();
+  }
+
+  // 係数更新を次ブロックまで保留する。更新はFilterの走査に融合して反映される。
+  // レンダーパワー不足などでゲインが全ビン0なら、係数の更新は省略して正規化だけを保留する。
+  void ScheduleAdaptation(const RenderBuffer& render_buffer, const FftData& G) {
+    pending_gain_.CopyFrom(G);
+    pending_position_ = render_buffer.Position();
+    update_pending_ = true;
+    pending_gain_is_zero_ = true;
+    for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
+      if (G.re[k] != 0.f || G.im[k] != 0.f) {
+        pending_gain_is_zero_ = false;
+        break;
+      }
+    }
+  }
+
+  // 保留中の係数更新と正規化を反映しながらフィルタ出力Sを生成する。
+  // 更新後の係数は即時に更新・正規化した場合と同じになる。
+  void Filter(const RenderBuffer& render_buffer, AlignedFftData* S) {
+    if (!update_pending_) {
+      ApplyFilter(render_buffer, size_partitions_, H_, S);
+      return;
+    }
+    update_pending_ = false;
+    if (pending_gain_is_zero_) {
+      // H += conj(X)·0 は係数を変えないので、正規化してから出力だけを作る。
+      Constrain();
+      ApplyFilter(render_buffer, size_partitions_, H_, S);
+      return;
+    }
+    const size_t size = render_buffer.GetFftBuffer().size();
+    if (render_buffer.Position() != (pending_position_ + size - 1) % size) {
+      // 読み出し位置が1ブロック進んでいない場合は融合できないので個別に反映する。
+      AdaptPartitions(render_buffer, pending_position_, pending_gain_,
+                      size_partitions_, &H_);
+      Constrain();
+      ApplyFilter(render_buffer, size_partitions_, H_, S);
+      return;
+    }
+    S->re.fill(0.f);
+    S->im.fill(0.f);
+    // 正規化対象のパーティションは、更新し終えてから出力に使うまでの間に正規化する。
+    const size_t c = partition_to_constrain_;
+    AdaptAndApplyPartitions(render_buffer, pending_gain_, size_partitions_,
+                            c + 1, size_partitions_ + 1, &H_, S);
+    Constrain();
+    AdaptAndApplyPartitions(render_buffer, pending_gain_, size_partitions_,
+                            0, c + 1, &H_, S);
   }
 
   // フィルタパーティションを巡回しながら正規化する。
@@ -195,6 +526,20 @@ struct AdaptiveFirFilter {
       std::fill(h.begin() + kFftLengthBy2, h.end(), 0.f);
       Fft(&h, &H_[partition_to_constrain_]);
     }
+    AdvancePartitionToConstrain();
+  }
+
+  // ビンkのERL（全パーティションの |H|² の和）を求める。
+  // FilterUpdateGain::Compute が H_error の更新に使うビンだけ、読むときに計算する。
+  float Erl(size_t k) const {
+    float erl = 0.f;
+    for (size_t p = 0; p < size_partitions_; ++p) {
+      erl += H_[p].re[k] * H_[p].re[k] + H_[p].im[k] * H_[p].im[k];
+    }
+    return erl;
+  }
+
+  void AdvancePartitionToConstrain() {
     partition_to_constrain_ =
         partition_to_constrain_ < (size_partitions_ - 1)
             ? partition_to_constrain_ + 1
@@ -222,12 +567,12 @@ struct FilterUpdateGain {
   }
 
   // 更新ゲインを計算する。
-  // render_power: レンダー信号パワー, subtractor_output: 減算器の出力統計, erl: 推定ERL, size_partitions: パーティション数, gain_fft: 出力先
+  // render_power: レンダー信号パワー, subtractor_output: 減算器の出力統計, filter: ERLを求める適応フィルタ, gain_fft: 出力先
   void Compute(const std::array<float, kFftLengthBy2Plus1>& render_power,
                const SubtractorOutput& subtractor_output,
-               std::span<const float> erl,
-               size_t size_partitions,
+               const AdaptiveFirFilter& filter,
                FftData* gain_fft) {
+    const size_t size_partitions = filter.size_partitions_;
     const FftData& E = subtractor_output.E;
     const std::array<float, kFftLengthBy2Plus1>& E2 = subtractor_output.E2;
     FftData* G = gain_fft;
@@ -258,11 +603,17 @@ struct FilterUpdateGain {
     }
     const bool filter_ok = (subtractor_output.e2 <= 0.5f * subtractor_output.y2);
     for (size_t k = 0; k < kFftLengthBy2Plus1; ++k) {
-      // 収束時はリーク係数0.00005f、発散時は0.05fでH_errorにERLを加算し、[0.001f, 2.f]でクランプ
+      // 収束時はリーク係数0.00005f、発散時は0.05fでH_errorにERLを加算し、[0.001f, 2.f]でクランプ。
+      // ERLは非負なので、H_errorが既に上限にあるビンは結果が2.fに決まりERLを求めなくてよい。
+      if (H_error_[k] >= 2.f) {
+        H_error_[k] = 2.f;
+        continue;
+      }
+      const float erl = filter.Erl(k);
       if (filter_ok) {
-        H_error_[k] += 0.00005f * erl[k];
+        H_error_[k] += 0.00005f * erl;
       } else {
-        H_error_[k] += 0.05f * erl[k];
+        H_error_[k] += 0.05f * erl;
       }
       H_error_[k] = std::max(H_error_[k], 0.001f);
       H_error_[k] = std::min(H_error_[k], 2.f);
@@ -272,7 +623,7 @@ struct FilterUpdateGain {
 
 // FFT 復元から予測誤差を計算するヘルパー。
 // S: フィルタ出力の周波数表現, y: キャプチャ信号, e: 残差信号の書き込み先
-inline void PredictionError(const FftData& S,
+inline void PredictionError(const AlignedFftData& S,
                             std::span<const float> y,
                             std::array<float, kBlockSize>* e) {
   std::array<float, kFftLength> tmp;
@@ -289,17 +640,10 @@ struct Subtractor {
   static constexpr size_t kFilterLengthBlocks = 13; // 適応FIRフィルタの長さ（ブロック数）
   AdaptiveFirFilter filter_; // 線形エコー推定用の適応FIRフィルタ
   FilterUpdateGain update_gain_; // フィルタ係数を更新するためのゲイン計算器
-  std::vector<std::array<float, kFftLengthBy2Plus1>> frequency_response_; // フィルタの周波数応答を保持
 
   Subtractor()
       : filter_(kFilterLengthBlocks),
-        update_gain_(),
-        frequency_response_(
-            std::vector<std::array<float, kFftLengthBy2Plus1>>(kFilterLengthBlocks)) {
-    for (std::array<float, kFftLengthBy2Plus1>& H2_k : frequency_response_) {
-      H2_k.fill(0.f);
-    }
-  }
+        update_gain_() {}
   
 
   // エコー減算処理を実行する。
@@ -318,11 +662,12 @@ struct Subtractor {
       FftData& E = out.E; // 残差信号の周波数表現
       std::array<float, kBlockSize>& e = out.e; // 残差信号の時間領域配列
 
-      FftData S; // 線形フィルタ出力の周波数表現
-      FftData& G = S; // update_gain_.Compute が上書きするゲイン格納先として再利用
+      AlignedFftData S; // 線形フィルタ出力の周波数表現
+      FftData G; // フィルタ更新ゲイン
 
-      // 線形フィルタの出力を形成。
-      ApplyFilter(render_buffer, filter_.size_partitions_, filter_.H_, &S);
+      // 前ブロックで保留した係数更新を反映しつつ、線形フィルタの出力を形成。
+      filter_.Filter(render_buffer, &S);
+      S.Spectrum(out.S2);
       PredictionError(S, y, &e);
 
       // 減算器出力の信号パワーを計算。
@@ -334,16 +679,9 @@ struct Subtractor {
       // 将来利用のためスペクトルを保存。
       E.Spectrum(out.E2);
 
-      // フィルタを更新。
-      std::array<float, kFftLengthBy2Plus1> erl; // Echo Return Loss（周波数応答）
-      ComputeErl(frequency_response_, erl);
-      update_gain_.Compute(X2, out, erl,
-                           filter_.size_partitions_,
-                           &G);
-      AdaptPartitions(render_buffer, G, filter_.size_partitions_, &filter_.H_);
-      filter_.Constrain();
-      frequency_response_.resize(filter_.size_partitions_);
-      ComputeFrequencyResponse(filter_.size_partitions_, filter_.H_, &frequency_response_);
+      // フィルタ更新ゲインを計算。ERLは必要なビンだけCompute内で求める。係数への反映は次ブロックのFilterで行う。
+      update_gain_.Compute(X2, out, filter_, &G);
+      filter_.ScheduleAdaptation(render_buffer, G);
     }
   }
 
@@ -351,5 +689,11 @@ struct Subtractor {
     filter_.HandleEchoPathChange();
     update_gain_.HandleEchoPathChange();
   }
+
+  // レンダーが無音でこのブロックの処理を省略するときに呼ぶ。
+  // 保留中の係数更新はレンダーFFTバッファが上書きされる前に反映しておく。
+  void Bypass(const RenderBuffer& render_buffer) {
+    filter_.FlushPendingAdaptation(render_buffer);
+  }
 };
 
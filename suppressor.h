@@ -197,6 +197,27 @@ struct SuppressionFilter {
       if (e0[i] > 32767.f) e0[i] = 32767.f;
     }
   }
+
+  // 全帯域ゲイン1で ApplyGain と同じ合成を行う（変換不要）。
+  // 入力フレームは [e_old, e_new] に平方根ハニング窓を掛けたもので、Ifft(Fft(v)) = kFftLengthBy2 * v なので
+  // e_extended の前半は kFftLengthBy2 * w[i] * e_old[i]、後半は kFftLengthBy2 * w[64+i] * e_new[i] になる。
+  // 出力は ApplyGain と同じく1ブロック遅れ（e_old の再構成）となり、重ね合わせ状態もそのまま引き継がれる。
+  void ApplyUnitGain(std::span<const float> e_old,
+                     std::span<const float> e_new,
+                     Block* e) {
+    const float kIfftNormalization = 2.f / static_cast<float>(kFftLength);
+    const float kIfftScale = static_cast<float>(kFftLengthBy2);
+    std::span<float, kBlockSize> e0(*e);
+    for (size_t i = 0; i < kFftLengthBy2; ++i) {
+      const float w = kSqrtHanning128[i];
+      float e0_i = e_output_old_[i] * kSqrtHanning128[kFftLengthBy2 + i];
+      e0_i += kIfftScale * w * w * e_old[i];
+      e0[i] = std::min(std::max(e0_i * kIfftNormalization, -32768.f), 32767.f);
+    }
+    for (size_t i = 0; i < kFftLengthBy2; ++i) {
+      e_output_old_[i] = kIfftScale * kSqrtHanning128[kFftLengthBy2 + i] * e_new[i];
+    }
+  }
 };
 
  
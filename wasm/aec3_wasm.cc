@@ -1,6 +1,8 @@
-// Minimal C API wrapper for EchoCanceller3 to compile with Emscripten.
+// Minimal C API wrapper for AEC3 to compile with Emscripten.
 // - 16kHz mono, 64-sample blocks only
 // - Exposes create/destroy, mode set, analyze (render), process (capture)
+// - aec3_process_frames processes many blocks per call on buffers that stay in the WASM heap
+// - Built with -msimd128 (make wasm-simd), the FFT/filter/matched-filter kernels use WASM SIMD
 
 #include <cstdint>
 #include <cstdlib>
@@ -13,9 +15,11 @@
 #endif
 
 #include "all.h"
+#include "multi_session.h"
 
+// RenderDelayBuffer + EchoPathDelayEstimator + EchoRemover の組（EchoCancellerSession）を1つ持つ。
 struct Aec3Handle {
-  EchoCanceller3 aec;
+  EchoCancellerSession session{DelaySearchConfig{}};
   Block render_block;
   Block capture_block;
 };
@@ -36,35 +40,67 @@ KEEPALIVE void aec3_destroy(void* handle) {
 KEEPALIVE void aec3_set_modes(void* handle, int enable_linear, int enable_nonlinear) {
   if (!handle) return;
   auto* h = reinterpret_cast<Aec3Handle*>(handle);
-  h->aec.SetProcessingModes(enable_linear != 0, enable_nonlinear != 0);
+  h->session.echo_remover_.SetProcessingModes(enable_linear != 0, enable_nonlinear != 0);
 }
 
-// Analyze a 64-sample render block (reference)
+// Delay estimation options: fft_delay selects the FFT cross-correlation matched filter,
+// tracking enables low-power tracking of a stable delay (see EchoPathDelayEstimator).
+KEEPALIVE void aec3_set_delay_estimation(void* handle, int fft_delay, int tracking) {
+  if (!handle) return;
+  auto* h = reinterpret_cast<Aec3Handle*>(handle);
+  h->session.delay_estimator_.SetFftMatchedFilter(fft_delay != 0);
+  h->session.delay_estimator_.SetLowPowerTracking(tracking != 0);
+}
+
+// Skip the linear filter and suppressor while the render is silent (enabled by default).
+KEEPALIVE void aec3_set_render_gating(void* handle, int enable) {
+  if (!handle) return;
+  auto* h = reinterpret_cast<Aec3Handle*>(handle);
+  h->session.echo_remover_.SetRenderGating(enable != 0);
+}
+
+// Analyze a 64-sample render block (reference). Call once before each aec3_process.
 KEEPALIVE void aec3_analyze(void* handle, const int16_t* ref64) {
   if (!handle || !ref64) return;
   auto* h = reinterpret_cast<Aec3Handle*>(handle);
-  h->render_block.CopyFromPcm16(ref64);
-  h->aec.render_transfer_queue_.push_back(h->render_block);
-  if (h->aec.render_transfer_queue_.size() > 100) {
-    h->aec.render_transfer_queue_.pop_front();
-  }
+  CopyFromPcm16(ref64, &h->render_block);
+  h->session.render_buffer_.Insert(h->render_block);
 }
 
 // Process a 64-sample capture block and write 64 samples to out64
 KEEPALIVE void aec3_process(void* handle, const int16_t* cap64, int16_t* out64) {
   if (!handle || !cap64 || !out64) return;
   auto* h = reinterpret_cast<Aec3Handle*>(handle);
-  h->capture_block.CopyFromPcm16(cap64);
-  h->aec.ProcessBlock(&h->capture_block, nullptr);
-  h->capture_block.CopyToPcm16(out64);
+  EchoCancellerSession& s = h->session;
+  CopyFromPcm16(cap64, &h->capture_block);
+  ProcessCaptureBlock(&s.render_buffer_, &s.delay_estimator_, &s.echo_remover_,
+                      &s.estimated_delay_blocks_, &h->capture_block);
+  CopyToPcm16(h->capture_block, out64);
+}
+
+// Process nblocks consecutive 64-sample blocks in one call
+// (same result as aec3_analyze + aec3_process per block).
+// render/capture/out point to nblocks*64 samples in the WASM heap; out may equal capture.
+// Returns the number of blocks processed.
+KEEPALIVE int aec3_process_frames(void* handle, const int16_t* render, const int16_t* capture,
+                                  int16_t* out, int nblocks) {
+  if (!handle || !render || !capture || !out || nblocks <= 0) return 0;
+  auto* h = reinterpret_cast<Aec3Handle*>(handle);
+  for (int n = 0; n < nblocks; ++n) {
+    const size_t offset = static_cast<size_t>(n) * kBlockSize;
+    CopyFromPcm16(render + offset, &h->render_block);
+    CopyFromPcm16(capture + offset, &h->capture_block);
+    h->session.ProcessBlock(h->render_block, &h->capture_block);
+    CopyToPcm16(h->capture_block, out + offset);
+  }
+  return nblocks;
 }
 
 // Optional: expose the current estimated delay (in blocks), -1 if not available
 KEEPALIVE int aec3_get_estimated_delay_blocks(void* handle) {
   if (!handle) return -1;
   auto* h = reinterpret_cast<Aec3Handle*>(handle);
-  return h->aec.block_processor_.estimated_delay_blocks_;
+  return h->session.estimated_delay_blocks_;
 }
 
 }
-